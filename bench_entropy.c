@@ -0,0 +1,141 @@
+/* Check and benchmark of the integer log2 behind shannon_entropy().
+ *
+ * log2_lshift16() is first compared with its definition, computed in floating
+ * point, for every argument up to 2^17 and a few larger ones: any difference
+ * fails the run.  Then shannon_entropy() is called on random strings of each
+ * length for a while, and the calls per second are reported.
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log2_lshift16.h"
+#include "random.h"
+
+#define MAX_SIZES 16
+
+/* Strings of each length are processed for about this long */
+#define BENCH_NS 500000000.0
+
+/* Distinct strings of each length, cycled through */
+#define N_STRINGS 256
+
+double shannon_entropy(const uint8_t *s);
+
+/* The definition generated by scripts/gen-log2.py: the result v is reached
+ * at round(2^16 * 2^((v - 1) / 8)), from -136 up to 0
+ */
+static int reference(uint64_t x)
+{
+    int ret = -136;
+    for (int v = -135; v <= 0; v++) {
+        if (floor(LOG2_ARG_SHIFT * exp2((v - 1) / 8.0) + 0.5) <= x)
+            ret = v;
+    }
+    return ret;
+}
+
+static bool check(void)
+{
+    static const uint64_t large[] = {1ULL << 20, 1ULL << 32, UINT64_MAX};
+    int bad = 0;
+
+    for (uint64_t x = 0; x <= 1 << 17; x++) {
+        if (log2_lshift16(x) != reference(x) && bad++ < 10)
+            printf("log2_lshift16(%lu) = %d, should be %d\n", (unsigned long) x,
+                   log2_lshift16(x), reference(x));
+    }
+    for (size_t i = 0; i < sizeof(large) / sizeof(large[0]); i++) {
+        if (log2_lshift16(large[i]) != reference(large[i]))
+            bad++;
+    }
+    if (bad)
+        printf("log2_lshift16() differs from its definition %d times\n", bad);
+    return !bad;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(size_t len)
+{
+    uint8_t *strings = malloc(N_STRINGS * (len + 1));
+    if (!strings) {
+        perror("malloc");
+        exit(1);
+    }
+
+    /* Random bytes but the terminating null byte */
+    uintptr_t seed = len;
+    for (size_t i = 0; i < N_STRINGS * (len + 1); i++) {
+        seed = random_shuffle(seed);
+        strings[i] = 1 + seed % 255;
+    }
+    for (size_t i = 0; i < N_STRINGS; i++)
+        strings[i * (len + 1) + len] = '\0';
+
+    uint64_t calls = 0;
+    double sum = 0, start = now_ns(), elapsed;
+    do {
+        for (size_t i = 0; i < N_STRINGS; i++)
+            sum += shannon_entropy(strings + i * (len + 1));
+        calls += N_STRINGS;
+    } while ((elapsed = now_ns() - start) < BENCH_NS);
+
+    printf("%9zu %14.0f %10.1f %9.2f%%\n", len, calls * 1e9 / elapsed,
+           elapsed / calls, sum / calls);
+    free(strings);
+}
+
+static void usage(char *cmd)
+{
+    printf("Usage: %s [-h] [-s SIZES]\n", cmd);
+    printf("\t-h         Print this information\n");
+    printf("\t-s SIZES   Comma-separated list of string lengths "
+           "(default: 8,64,1024)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizes[MAX_SIZES] = {8, 64, 1024};
+    int nsizes = 3;
+
+    int c;
+    while ((c = getopt(argc, argv, "hs:")) != -1) {
+        switch (c) {
+        case 's':
+            nsizes = 0;
+            for (char *tok = strtok(optarg, ","); tok && nsizes < MAX_SIZES;
+                 tok = strtok(NULL, ","))
+                sizes[nsizes++] = strtoul(tok, NULL, 10);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!check())
+        return 1;
+    printf("log2_lshift16() matches its definition\n");
+
+    printf("%9s %14s %10s %10s\n", "length", "calls/s", "ns/call",
+           "entropy");
+    for (int s = 0; s < nsizes; s++) {
+        if (sizes[s] > 0)
+            bench(sizes[s]);
+    }
+    return 0;
+}
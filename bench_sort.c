@@ -0,0 +1,444 @@
+/* Benchmark of the sorting algorithms on queues.
+ *
+ * Every algorithm sorts the same inputs, rebuilt in their original order
+ * before each run, and the median of the runs is reported per element: time,
+ * comparisons (for the algorithms taking a comparison function, and for
+ * q_sort when built with "make STATS=1") and the hardware events
+ * perf_event_open(2) can count.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The benchmark allocates its own nodes */
+#define INTERNAL 1
+#include "queue.h"
+
+#include "list_sort.h"
+#include "perfcnt.h"
+#include "random.h"
+#include "stats.h"
+
+#define MAX_SIZES 16
+#define MAX_RUNS 101
+
+/* Length of the random part of the generated strings */
+#define KEY_LEN 8
+
+/* Common prefix of the strings in the "prefix" input */
+#define PREFIX "lab0-c/queue/element/value/"
+
+static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
+
+/* The queue code allocates through the test harness, which is not linked:
+ * the benchmark does not check allocations, so hand them to the C library.
+ */
+void *test_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void test_free(void *p)
+{
+    free(p);
+}
+
+char *test_strdup(const char *s)
+{
+    return strdup(s);
+}
+
+static uintptr_t seed = 1;
+
+static uintptr_t next_random()
+{
+    seed += (uintptr_t) 0x9e3779b97f4a7c15ULL;
+    return random_shuffle(seed);
+}
+
+static void random_key(char *buf)
+{
+    uintptr_t r = next_random();
+    for (int i = 0; i < KEY_LEN; i++) {
+        buf[i] = charset[r % (sizeof(charset) - 1)];
+        r /= sizeof(charset) - 1;
+    }
+    buf[KEY_LEN] = '\0';
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* Fill values with n random strings, each including prefix */
+static void fill_random(char **values, size_t n, const char *prefix)
+{
+    size_t plen = strlen(prefix);
+    for (size_t i = 0; i < n; i++) {
+        values[i] = malloc(plen + KEY_LEN + 1);
+        memcpy(values[i], prefix, plen);
+        random_key(values[i] + plen);
+    }
+}
+
+static void reverse_values(char **values, size_t n)
+{
+    for (size_t i = 0, j = n - 1; i < j; i++, j--) {
+        char *tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+static void gen_random(char **values, size_t n)
+{
+    fill_random(values, n, "");
+}
+
+static void gen_sorted(char **values, size_t n)
+{
+    fill_random(values, n, "");
+    qsort(values, n, sizeof(char *), cmp_str);
+}
+
+static void gen_reversed(char **values, size_t n)
+{
+    gen_sorted(values, n);
+    reverse_values(values, n);
+}
+
+static void gen_few_unique(char **values, size_t n)
+{
+    char keys[16][KEY_LEN + 1];
+    for (int i = 0; i < 16; i++)
+        random_key(keys[i]);
+    for (size_t i = 0; i < n; i++)
+        values[i] = strdup(keys[next_random() % 16]);
+}
+
+/* Ascending first half, descending second half */
+static void gen_organ_pipe(char **values, size_t n)
+{
+    gen_sorted(values, n);
+    char **tmp = malloc(n * sizeof(char *));
+    for (size_t i = 0; i < n; i++)
+        tmp[i % 2 ? n - 1 - i / 2 : i / 2] = values[i];
+    memcpy(values, tmp, n * sizeof(char *));
+    free(tmp);
+}
+
+static void gen_prefix(char **values, size_t n)
+{
+    fill_random(values, n, PREFIX);
+}
+
+static const struct input {
+    const char *name;
+    void (*gen)(char **values, size_t n);
+} inputs[] = {
+    {"random", gen_random},     {"sorted", gen_sorted},
+    {"reversed", gen_reversed}, {"few-unique", gen_few_unique},
+    {"organ-pipe", gen_organ_pipe}, {"prefix", gen_prefix},
+};
+
+/* Comparisons made by the algorithms going through value_cmp() */
+static uint64_t ncmp;
+
+static inline int value_cmp(void *priv,
+                            const struct list_head *a,
+                            const struct list_head *b)
+{
+    ncmp++;
+    return strcmp(list_entry(a, element_t, list)->value,
+                  list_entry(b, element_t, list)->value);
+}
+
+static LIST_SORT_DEFINE(list_sort_value, value_cmp);
+
+static void run_q_sort(struct list_head *head)
+{
+#ifdef QUEUE_STATS
+    uint64_t before = queue_stats.cmps;
+    q_sort(head);
+    ncmp = queue_stats.cmps - before;
+#else
+    q_sort(head);
+#endif
+}
+
+#ifdef QUEUE_STATS
+#define Q_SORT_COUNTS true
+#else
+#define Q_SORT_COUNTS false
+#endif
+
+static void run_list_sort(struct list_head *head)
+{
+    list_sort(NULL, head, value_cmp);
+}
+
+static void run_list_sort_value(struct list_head *head)
+{
+    list_sort_value(NULL, head);
+}
+
+/* Recursive top-down merge sort, the textbook alternative */
+static struct list_head *topdown(struct list_head *head)
+{
+    if (!head || !head->next)
+        return head;
+    struct list_head *slow = head;
+    for (struct list_head *fast = head->next; fast && fast->next;
+         fast = fast->next->next)
+        slow = slow->next;
+    struct list_head *b = topdown(slow->next), *a;
+    slow->next = NULL;
+    a = topdown(head);
+
+    struct list_head *merged = NULL, **tail = &merged;
+    while (a && b) {
+        struct list_head **node = value_cmp(NULL, a, b) <= 0 ? &a : &b;
+        *tail = *node;
+        tail = &(*tail)->next;
+        *node = (*node)->next;
+    }
+    *tail = a ? a : b;
+    return merged;
+}
+
+/* Rebuild the prev links and the circular structure of a sorted chain */
+static void relink(struct list_head *head, struct list_head *first)
+{
+    struct list_head *prev = head;
+    head->next = first;
+    for (struct list_head *node = first; node; node = node->next) {
+        node->prev = prev;
+        prev = node;
+    }
+    prev->next = head;
+    head->prev = prev;
+}
+
+static void run_topdown(struct list_head *head)
+{
+    head->prev->next = NULL;
+    relink(head, topdown(head->next));
+}
+
+static int elem_cmp(const void *a, const void *b)
+{
+    ncmp++;
+    return strcmp((*(element_t *const *) a)->value,
+                  (*(element_t *const *) b)->value);
+}
+
+/* Copy the nodes into an array, sort it with qsort() and relink */
+static void run_qsort(struct list_head *head)
+{
+    size_t n = 0;
+    struct list_head *node;
+    list_for_each (node, head)
+        n++;
+    element_t **arr = malloc(n * sizeof(element_t *));
+    if (!arr)
+        return;
+    size_t i = 0;
+    element_t *e;
+    list_for_each_entry (e, head, list)
+        arr[i++] = e;
+    qsort(arr, n, sizeof(element_t *), elem_cmp);
+    INIT_LIST_HEAD(head);
+    for (i = 0; i < n; i++)
+        list_add_tail(&arr[i]->list, head);
+    free(arr);
+}
+
+static const struct algorithm {
+    const char *name;
+    void (*sort)(struct list_head *head);
+    bool counts; /* are comparisons counted? */
+} algorithms[] = {
+    {"q_sort", run_q_sort, Q_SORT_COUNTS},
+    {"list_sort", run_list_sort, true},
+    {"list_sort/def", run_list_sort_value, true},
+    {"topdown", run_topdown, true},
+    {"qsort", run_qsort, true},
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int n)
+{
+    qsort(v, n, sizeof(double), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool is_sorted(struct list_head *head, size_t n)
+{
+    size_t cnt = 0;
+    struct list_head *node;
+    list_for_each (node, head) {
+        cnt++;
+        if (node->next != head &&
+            strcmp(list_entry(node, element_t, list)->value,
+                   list_entry(node->next, element_t, list)->value) > 0)
+            return false;
+    }
+    return cnt == n;
+}
+
+static void bench(const struct input *in,
+                  size_t n,
+                  int runs,
+                  struct perfcnt *pc,
+                  bool has_perf)
+{
+    char **values = malloc(n * sizeof(char *));
+    element_t *nodes = malloc(n * sizeof(element_t));
+    if (!values || !nodes) {
+        fprintf(stderr, "Out of memory for %zu elements\n", n);
+        exit(1);
+    }
+    in->gen(values, n);
+    for (size_t i = 0; i < n; i++)
+        nodes[i].value = values[i];
+
+    for (size_t a = 0; a < ARRAY_SIZE(algorithms); a++) {
+        const struct algorithm *alg = &algorithms[a];
+        double t[MAX_RUNS], c[MAX_RUNS], ev[PERFCNT_EVENTS][MAX_RUNS];
+        for (int r = 0; r < runs; r++) {
+            LIST_HEAD(head);
+            for (size_t i = 0; i < n; i++)
+                list_add_tail(&nodes[i].list, &head);
+
+            ncmp = 0;
+            perfcnt_start(pc);
+            double start = now_ns();
+            alg->sort(&head);
+            t[r] = (now_ns() - start) / n;
+            perfcnt_stop(pc);
+            c[r] = (double) ncmp / n;
+            for (int e = 0; e < PERFCNT_EVENTS; e++)
+                ev[e][r] = (double) pc->value[e] / n;
+
+            if (!is_sorted(&head, n)) {
+                fprintf(stderr, "%s did not sort %s input of %zu elements\n",
+                        alg->name, in->name, n);
+                exit(1);
+            }
+        }
+
+        printf("%-10s %9zu  %-13s %9.1f", in->name, n, alg->name,
+               median(t, runs));
+        if (alg->counts)
+            printf(" %9.2f", median(c, runs));
+        else
+            printf(" %9s", "-");
+        if (has_perf) {
+            for (int e = 0; e < PERFCNT_EVENTS; e++) {
+                if (perfcnt_valid(pc, e))
+                    printf(" %12.3f", median(ev[e], runs));
+                else
+                    printf(" %12s", "-");
+            }
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        free(values[i]);
+    free(values);
+    free(nodes);
+}
+
+static void usage(char *cmd)
+{
+    printf("Usage: %s [-h] [-s SIZES] [-r RUNS] [-i INPUT]\n", cmd);
+    printf("\t-h         Print this information\n");
+    printf("\t-s SIZES   Comma-separated list of sizes "
+           "(default: 1000,10000,100000,1000000)\n");
+    printf("\t-r RUNS    Runs per measurement, median is reported "
+           "(default: 5)\n");
+    printf("\t-i INPUT   Only run one input among:");
+    for (size_t i = 0; i < ARRAY_SIZE(inputs); i++)
+        printf(" %s", inputs[i].name);
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizes[MAX_SIZES] = {1000, 10000, 100000, 1000000};
+    int nsizes = 4, runs = 5;
+    const char *only = NULL;
+
+    int c;
+    while ((c = getopt(argc, argv, "hs:r:i:")) != -1) {
+        switch (c) {
+        case 's':
+            nsizes = 0;
+            for (char *tok = strtok(optarg, ","); tok && nsizes < MAX_SIZES;
+                 tok = strtok(NULL, ","))
+                sizes[nsizes++] = strtoul(tok, NULL, 10);
+            break;
+        case 'r':
+            runs = atoi(optarg);
+            break;
+        case 'i':
+            only = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs < 1 || runs > MAX_RUNS) {
+        fprintf(stderr, "Runs should be 1-%d\n", MAX_RUNS);
+        return 1;
+    }
+
+    struct perfcnt pc;
+    bool has_perf = perfcnt_open(&pc);
+    if (!has_perf)
+        printf("# Hardware counters unavailable, only timing is reported\n");
+
+    printf("%-10s %9s  %-13s %9s %9s", "input", "size", "algorithm",
+           "ns/elem", "cmp/elem");
+    if (has_perf) {
+        for (int e = 0; e < PERFCNT_EVENTS; e++)
+            printf(" %12s", perfcnt_name(e));
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < ARRAY_SIZE(inputs); i++) {
+        if (only && strcmp(only, inputs[i].name))
+            continue;
+        for (int s = 0; s < nsizes; s++) {
+            if (sizes[s] > 0)
+                bench(&inputs[i], sizes[s], runs, &pc, has_perf);
+        }
+    }
+
+    perfcnt_close(&pc);
+    return 0;
+}
@@ -0,0 +1,420 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "complexity.h"
+#include "queue.h"
+#include "random.h"
+#include "report.h"
+
+/* Queue sizes grow by a factor of CX_GROWTH from CX_MIN_SIZE */
+#define CX_MIN_SIZE 1024
+#define CX_GROWTH 4
+
+/* Calls timed at each size: as many as fit in CX_BUDGET_NS, within bounds */
+#define CX_MIN_REPS 3
+#define CX_MAX_REPS 101
+#define CX_BUDGET_NS (200 * 1000 * 1000)
+
+/* Length of the strings of the queues */
+#define CX_STRLEN 9
+
+/**
+ * struct cx_state - Queues an operation runs on
+ * @ctx: the queues; all operations but merge only use the first one
+ * @chain: chain of the queues, for merge
+ * @n: number of elements of the queues
+ * @e: element a removal returned
+ * @seed: state of the generator of random strings
+ * @str: string to insert, with room for any int
+ * @ok: whether the operation succeeded
+ */
+struct cx_state {
+    queue_contex_t ctx[2];
+    struct list_head chain;
+    int n;
+    element_t *e;
+    uintptr_t seed;
+    char str[16];
+    bool ok;
+};
+
+/**
+ * struct cx_op - Operation whose complexity is measured
+ * @name: qtest command running the operation
+ * @func: queue function measured
+ * @grow: bring the queues to a size, not measured
+ * @run: the operation, measured
+ * @undo: check the operation and bring the queues back to their state, not
+ *        measured
+ */
+struct cx_op {
+    const char *name, *func;
+    bool (*grow)(struct cx_state *, int);
+    void (*run)(struct cx_state *);
+    bool (*undo)(struct cx_state *);
+};
+
+static char *random_string(struct cx_state *st)
+{
+    for (int i = 0; i < CX_STRLEN; i++) {
+        st->seed += (uintptr_t) 0x9e3779b97f4a7c15ULL;
+        st->str[i] = 'a' + random_shuffle(st->seed) % 26;
+    }
+    st->str[CX_STRLEN] = '\0';
+    return st->str;
+}
+
+/* Insert random strings at the head of the queue, so that the newest
+ * elements are met first when the queue is freed
+ */
+static bool grow_random(struct cx_state *st, int n)
+{
+    for (; st->n < n; st->n++) {
+        if (!q_insert_head(st->ctx[0].q, random_string(st)))
+            return false;
+    }
+    return true;
+}
+
+/* Two queues of increasing numbers, taken in turn, so that merging them
+ * compares every element
+ */
+static bool grow_merge(struct cx_state *st, int n)
+{
+    /* Both queues are built again to keep them sorted */
+    for (int i = 1; i >= 0; i--) {
+        struct list_head *q = st->ctx[i].q;
+        while (!list_empty(q))
+            q_release_element(q_remove_tail(q, NULL, 0));
+    }
+    for (st->n = 0; st->n < n; st->n++) {
+        snprintf(st->str, sizeof(st->str), "%0*d", CX_STRLEN, st->n);
+        if (!q_insert_tail(st->ctx[st->n & 1].q, st->str))
+            return false;
+    }
+    st->ctx[0].size = (n + 1) / 2;
+    st->ctx[1].size = n / 2;
+    return true;
+}
+
+static void run_insert_head(struct cx_state *st)
+{
+    st->ok = q_insert_head(st->ctx[0].q, st->str);
+}
+
+static void run_insert_tail(struct cx_state *st)
+{
+    st->ok = q_insert_tail(st->ctx[0].q, st->str);
+}
+
+static bool undo_insert(struct cx_state *st, struct list_head *node)
+{
+    if (!st->ok)
+        return false;
+    list_del(node);
+    q_release_element(list_entry(node, element_t, list));
+    random_string(st);
+    return true;
+}
+
+static bool undo_insert_head(struct cx_state *st)
+{
+    return undo_insert(st, st->ctx[0].q->next);
+}
+
+static bool undo_insert_tail(struct cx_state *st)
+{
+    return undo_insert(st, st->ctx[0].q->prev);
+}
+
+static void run_remove_head(struct cx_state *st)
+{
+    st->e = q_remove_head(st->ctx[0].q, NULL, 0);
+}
+
+static void run_remove_tail(struct cx_state *st)
+{
+    st->e = q_remove_tail(st->ctx[0].q, NULL, 0);
+}
+
+static bool undo_remove_head(struct cx_state *st)
+{
+    if (!st->e)
+        return false;
+    list_add(&st->e->list, st->ctx[0].q);
+    return true;
+}
+
+static bool undo_remove_tail(struct cx_state *st)
+{
+    if (!st->e)
+        return false;
+    list_add_tail(&st->e->list, st->ctx[0].q);
+    return true;
+}
+
+static void run_size(struct cx_state *st)
+{
+    st->ok = q_size(st->ctx[0].q) == st->n;
+}
+
+static bool undo_none(struct cx_state *st)
+{
+    return st->ok;
+}
+
+static void run_delete_mid(struct cx_state *st)
+{
+    st->ok = q_delete_mid(st->ctx[0].q);
+}
+
+static bool undo_delete_mid(struct cx_state *st)
+{
+    return st->ok && q_insert_head(st->ctx[0].q, random_string(st));
+}
+
+static void run_swap(struct cx_state *st)
+{
+    q_swap(st->ctx[0].q);
+    st->ok = true;
+}
+
+static void run_reverse(struct cx_state *st)
+{
+    q_reverse(st->ctx[0].q);
+    st->ok = true;
+}
+
+static void run_sort(struct cx_state *st)
+{
+    q_sort(st->ctx[0].q);
+    st->ok = true;
+}
+
+/* Give the elements new random strings, for the next sort not to find them
+ * sorted
+ */
+static bool undo_sort(struct cx_state *st)
+{
+    element_t *e;
+    list_for_each_entry (e, st->ctx[0].q, list)
+        strncpy(e->value, random_string(st), CX_STRLEN + 1);
+    return st->ok;
+}
+
+static void run_merge(struct cx_state *st)
+{
+    st->ok = q_merge(&st->chain) == st->n;
+}
+
+/* Deal the merged elements back to both queues in turn */
+static bool undo_merge(struct cx_state *st)
+{
+    struct list_head *q = st->ctx[0].q, *node = q->next;
+    if (!st->ok || !list_empty(st->ctx[1].q))
+        return false;
+    while (node != q && node->next != q) {
+        struct list_head *next = node->next;
+        list_move_tail(next, st->ctx[1].q);
+        node = node->next;
+    }
+    st->ctx[0].size = (st->n + 1) / 2;
+    st->ctx[1].size = st->n / 2;
+    return true;
+}
+
+static const struct cx_op ops[] = {
+    {"ih", "q_insert_head", grow_random, run_insert_head, undo_insert_head},
+    {"it", "q_insert_tail", grow_random, run_insert_tail, undo_insert_tail},
+    {"rh", "q_remove_head", grow_random, run_remove_head, undo_remove_head},
+    {"rt", "q_remove_tail", grow_random, run_remove_tail, undo_remove_tail},
+    {"size", "q_size", grow_random, run_size, undo_none},
+    {"dm", "q_delete_mid", grow_random, run_delete_mid, undo_delete_mid},
+    {"swap", "q_swap", grow_random, run_swap, undo_none},
+    {"reverse", "q_reverse", grow_random, run_reverse, undo_none},
+    {"sort", "q_sort", grow_random, run_sort, undo_sort},
+    {"merge", "q_merge", grow_merge, run_merge, undo_merge},
+};
+
+const char *cx_names = "ih it rh rt size dm swap reverse sort merge";
+
+static const char *class_names[CX_CLASSES] = {
+    [CX_1] = "O(1)",
+    [CX_LOGN] = "O(log n)",
+    [CX_N] = "O(n)",
+    [CX_NLOGN] = "O(n log n)",
+    [CX_N2] = "O(n^2)",
+};
+
+/* Names of the classes on the command line */
+static const char *class_keys[CX_CLASSES] = {
+    [CX_1] = "1",
+    [CX_LOGN] = "logn",
+    [CX_N] = "n",
+    [CX_NLOGN] = "nlogn",
+    [CX_N2] = "n2",
+};
+
+const char *cx_class_name(enum cx_class c)
+{
+    return class_names[c];
+}
+
+int cx_parse_class(const char *s)
+{
+    for (int c = 0; c < CX_CLASSES; c++) {
+        if (!strcmp(s, class_keys[c]))
+            return c;
+    }
+    return -1;
+}
+
+static double class_func(enum cx_class c, double n)
+{
+    switch (c) {
+    case CX_1:
+        return 1;
+    case CX_LOGN:
+        return log2(n);
+    case CX_N:
+        return n;
+    case CX_NLOGN:
+        return n * log2(n);
+    default:
+        return n * n;
+    }
+}
+
+/* The fit compares the ratios t / f(n) of each class across sizes, on a
+ * logarithmic scale, so that it depends neither on the scale of the times nor
+ * on the largest sizes more than on the others.  For the class of the
+ * operation, the ratio stays about the same from one size to the next.
+ *
+ * Large queues no longer fit in the caches, which makes the time per element
+ * grow between some sizes, and never shrink.  The growth of the ratio between
+ * the two consecutive sizes where it grows the least is thus the one to go
+ * by: the class whose smallest growth is the closest to 0 fits best.
+ */
+enum cx_class cx_fit(const double *n,
+                     const double *t,
+                     int count,
+                     struct cx_fit fits[CX_CLASSES])
+{
+    enum cx_class best = CX_1;
+    for (int c = 0; c < CX_CLASSES; c++) {
+        double ratio[CX_MAX_SIZES], mean = 0;
+        for (int i = 0; i < count; i++) {
+            ratio[i] = log(t[i] > 0 ? t[i] : 1) - log(class_func(c, n[i]));
+            mean += ratio[i] / count;
+        }
+        fits[c].coef = exp(mean);
+        fits[c].slope = INFINITY;
+        for (int i = 1; i < count; i++) {
+            double s = (ratio[i] - ratio[i - 1]) / log(n[i] / n[i - 1]);
+            if (s < fits[c].slope)
+                fits[c].slope = s;
+        }
+        if (fabs(fits[c].slope) < fabs(fits[best].slope))
+            best = c;
+    }
+    return best;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* Median time of a call of the operation on queues of the current size */
+static bool measure_size(const struct cx_op *op,
+                         struct cx_state *st,
+                         double *median)
+{
+    uint64_t samples[CX_MAX_REPS], spent = 0;
+    int reps = 0;
+
+    while (reps < CX_MAX_REPS &&
+           (reps < CX_MIN_REPS || spent < CX_BUDGET_NS)) {
+        uint64_t start = time_ns();
+        op->run(st);
+        samples[reps] = time_ns() - start;
+        spent += samples[reps++];
+        if (!op->undo(st))
+            return false;
+    }
+
+    qsort(samples, reps, sizeof(samples[0]), cmp_u64);
+    *median = reps % 2 ? samples[reps / 2]
+                       : (samples[reps / 2 - 1] + samples[reps / 2]) / 2.0;
+    return true;
+}
+
+bool cx_measure(const char *name, int max_size, int expect)
+{
+    const struct cx_op *op = NULL;
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (!strcmp(ops[i].name, name))
+            op = &ops[i];
+    }
+    if (!op) {
+        report(1, "Unknown operation '%s', should be one of: %s", name,
+               cx_names);
+        return false;
+    }
+    if (max_size < CX_MIN_SIZE) {
+        report(1, "Largest size %d should be at least %d", max_size,
+               CX_MIN_SIZE);
+        return false;
+    }
+
+    struct cx_state st = {.seed = (uintptr_t) time_ns()};
+    INIT_LIST_HEAD(&st.chain);
+    for (int i = 0; i < 2; i++) {
+        st.ctx[i].q = q_new();
+        st.ctx[i].id = i;
+        list_add_tail(&st.ctx[i].chain, &st.chain);
+    }
+    random_string(&st);
+
+    double n[CX_MAX_SIZES], t[CX_MAX_SIZES];
+    int count = 0;
+    bool ok = st.ctx[0].q && st.ctx[1].q;
+    if (ok) {
+        report(1, "%s on queues of %d to %d elements", op->func, CX_MIN_SIZE,
+               max_size);
+        report(1, "%12s %16s", "Size", "Median (ns)");
+    }
+    for (long size = CX_MIN_SIZE; ok && size <= max_size; size *= CX_GROWTH) {
+        ok = op->grow(&st, size) && measure_size(op, &st, &t[count]);
+        if (!ok) {
+            report(1, "ERROR: %s failed on a queue of %ld elements", op->func,
+                   size);
+            break;
+        }
+        n[count] = size;
+        report(1, "%12ld %16.0f", size, t[count++]);
+    }
+
+    if (ok && count > 1) {
+        struct cx_fit fits[CX_CLASSES];
+        enum cx_class best = cx_fit(n, t, count, fits);
+        report(1, "%-12s %16s %10s", "Class", "ns per f(n)", "Slope");
+        for (int c = 0; c < CX_CLASSES; c++) {
+            report(1, "%-12s %16.4g %10.3f", class_names[c], fits[c].coef,
+                   fits[c].slope);
+        }
+        report(1, "Best fit: %s", class_names[best]);
+        if (expect >= 0 && best != (enum cx_class) expect) {
+            report(1, "ERROR: %s should be %s", op->func, class_names[expect]);
+            ok = false;
+        }
+    }
+
+    for (int i = 1; i >= 0; i--)
+        q_free(st.ctx[i].q);
+    return ok;
+}
@@ -0,0 +1,82 @@
+#ifndef LAB0_COMPLEXITY_H
+#define LAB0_COMPLEXITY_H
+
+/* Empirical time complexity of the queue operations.
+ *
+ * An operation runs on queues of geometrically increasing sizes, and the
+ * median time of a call at each size is divided by the function of each of
+ * the time complexity classes O(1), O(log n), O(n), O(n log n) and O(n^2).
+ * The class for which this ratio stays the most constant from one size to
+ * the next is the likely complexity of the operation.
+ */
+
+#include <stdbool.h>
+
+/* Most sizes a fit takes */
+#define CX_MAX_SIZES 32
+
+enum cx_class {
+    CX_1,
+    CX_LOGN,
+    CX_N,
+    CX_NLOGN,
+    CX_N2,
+    CX_CLASSES,
+};
+
+/**
+ * struct cx_fit - Fit of times against a complexity class
+ * @coef: time of a call is about @coef times the function of the class,
+ *        geometric mean over the sizes
+ * @slope: smallest slope of log(t / f(n)) against log(n) between two
+ *         consecutive sizes, 0 for a perfect fit, positive if the operation
+ *         grows faster than the class
+ */
+struct cx_fit {
+    double coef;
+    double slope;
+};
+
+/**
+ * cx_class_name() - Name of a complexity class, e.g. "O(n log n)"
+ * @c: complexity class
+ */
+const char *cx_class_name(enum cx_class c);
+
+/**
+ * cx_parse_class() - Find a complexity class by its short name
+ * @s: "1", "logn", "n", "nlogn" or "n2"
+ *
+ * Return: the class, -1 if there is none of that name
+ */
+int cx_parse_class(const char *s);
+
+/**
+ * cx_fit() - Fit times against every complexity class
+ * @n: sizes of the queues
+ * @t: time of a call at each size
+ * @count: number of sizes, at most CX_MAX_SIZES
+ * @fits: receives the fit of each class
+ *
+ * Return: the class fitting best
+ */
+enum cx_class cx_fit(const double *n,
+                     const double *t,
+                     int count,
+                     struct cx_fit fits[CX_CLASSES]);
+
+/**
+ * cx_measure() - Measure and report the complexity of an operation
+ * @name: qtest command of the operation, e.g. "size"
+ * @max_size: largest queue size
+ * @expect: class the operation should fit best, -1 for any
+ *
+ * Return: false if there is no such operation, a queue operation failed or
+ *         the operation does not fit @expect best
+ */
+bool cx_measure(const char *name, int max_size, int expect);
+
+/* qtest commands of the operations cx_measure() knows, separated by spaces */
+extern const char *cx_names;
+
+#endif /* LAB0_COMPLEXITY_H */
@@ -2,6 +2,7 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -12,6 +13,8 @@
 #include <unistd.h>
 
 #include "console.h"
+#include "latency.h"
+#include "perfcnt.h"
 #include "report.h"
 #include "web.h"
 
@@ -65,6 +68,20 @@ static bool has_infile = false;
 static cmd_func_t quit_helpers[MAXQUIT];
 static int quit_helper_cnt = 0;
 
+/* Optional functions to call around each command line */
+static cmd_hook_t before_hook = NULL, after_hook = NULL;
+
+/* Hardware events counted while "time" runs a command */
+static int time_perf = 0;
+static struct perfcnt time_counters;
+static bool time_counters_open = false;
+
+/* Optional function giving the number of elements for per element counts */
+static elem_func_t time_elements = NULL;
+
+/* Report the latencies of the commands on quit */
+static int latency_on_quit = 0;
+
 static void init_in();
 
 static bool push_file(char *fname);
@@ -87,6 +104,7 @@ void add_cmd(char *name, cmd_func_t operation, char *summary, char *param)
     cmd->operation = operation;
     cmd->summary = summary;
     cmd->param = param;
+    cmd->latency = NULL;
     cmd->next = next_cmd;
     *last_loc = cmd;
 }
@@ -178,7 +196,16 @@ static bool interpret_cmda(int argc, char *argv[])
     while (next_cmd && strcmp(argv[0], next_cmd->name) != 0)
         next_cmd = next_cmd->next;
     if (next_cmd) {
+        uint64_t start = time_ns();
         ok = next_cmd->operation(argc, argv);
+        uint64_t ns = time_ns() - start;
+        /* Quitting frees the command list */
+        if (!quit_flag) {
+            if (!next_cmd->latency)
+                next_cmd->latency = calloc_or_fail(1, sizeof(struct latency),
+                                                   "interpret_cmda");
+            lat_record(next_cmd->latency, ns);
+        }
         if (!ok)
             record_error();
     } else {
@@ -198,7 +225,11 @@ static bool interpret_cmd(char *cmdline)
 
     int argc;
     char **argv = parse_args(cmdline, &argc);
+    if (before_hook && argc)
+        before_hook(argc, argv);
     bool ok = interpret_cmda(argc, argv);
+    if (after_hook && argc)
+        after_hook(argc, argv);
     for (int i = 0; i < argc; i++)
         free_string(argv[i]);
     free_array(argv, argc, sizeof(char *));
@@ -215,6 +246,19 @@ void add_quit_helper(cmd_func_t qf)
         report_event(MSG_FATAL, "Exceeded limit on quit helpers");
 }
 
+/* Set functions to be executed before and after each command line */
+void set_cmd_hooks(cmd_hook_t before, cmd_hook_t after)
+{
+    before_hook = before;
+    after_hook = after;
+}
+
+/* Set function giving the number of elements the commands work on */
+void set_time_elements(elem_func_t f)
+{
+    time_elements = f;
+}
+
 /* Turn echoing on/off */
 void set_echo(bool on)
 {
@@ -222,13 +266,34 @@ void set_echo(bool on)
 }
 
 /* Built-in commands */
+static void report_latency()
+{
+    report(1, "%-12s %8s %12s %12s %12s %12s", "Command", "Count", "p50 (ns)",
+           "p90 (ns)", "p99 (ns)", "Max (ns)");
+    for (cmd_element_t *c = cmd_list; c; c = c->next) {
+        const struct latency *h = c->latency;
+        if (!h || !h->count)
+            continue;
+        report(1,
+               "%-12s %8" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+               " %12" PRIu64,
+               c->name, h->count, lat_percentile(h, 50),
+               lat_percentile(h, 90), lat_percentile(h, 99), h->max);
+    }
+}
+
 static bool do_quit(int argc, char *argv[])
 {
+    if (latency_on_quit)
+        report_latency();
+
     cmd_element_t *c = cmd_list;
     bool ok = true;
     while (c) {
         cmd_element_t *ele = c;
         c = c->next;
+        if (ele->latency)
+            free_array(ele->latency, 1, sizeof(struct latency));
         free_block(ele, sizeof(cmd_element_t));
     }
 
@@ -242,6 +307,11 @@ static bool do_quit(int argc, char *argv[])
     while (buf_stack)
         pop_file();
 
+    if (time_counters_open) {
+        perfcnt_close(&time_counters);
+        time_counters_open = false;
+    }
+
     for (int i = 0; i < quit_helper_cnt; i++) {
         ok = ok && quit_helpers[i](argc, argv);
     }
@@ -269,6 +339,24 @@ static bool do_help(int argc, char *argv[])
     return true;
 }
 
+static bool do_latency(int argc, char *argv[])
+{
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "reset"))) {
+        report(1, "%s takes no arguments, or 'reset'", argv[0]);
+        return false;
+    }
+
+    if (argc == 2) {
+        for (cmd_element_t *c = cmd_list; c; c = c->next) {
+            if (c->latency)
+                lat_reset(c->latency);
+        }
+        return true;
+    }
+    report_latency();
+    return true;
+}
+
 static bool do_comment_cmd(int argc, char *argv[])
 {
     if (echo)
@@ -371,6 +459,45 @@ static bool do_log(int argc, char *argv[])
     return result;
 }
 
+/* Open or close the hardware counters as option perf changes */
+static void set_time_perf(int oldval)
+{
+    if (time_perf && !time_counters_open) {
+        time_counters_open = perfcnt_open(&time_counters);
+        if (!time_counters_open) {
+            report(1, "Hardware counters unavailable, time reports only "
+                      "the elapsed time");
+            time_perf = 0;
+        }
+    } else if (!time_perf && time_counters_open) {
+        perfcnt_close(&time_counters);
+        time_counters_open = false;
+    }
+}
+
+/* Report the hardware events of the last timed command.  Dividing them by the
+ * number of elements tells whether a command is slow because of its memory
+ * accesses, its mispredicted branches, or just the number of instructions.
+ */
+static void report_perf(int elements)
+{
+    const struct perfcnt *pc = &time_counters;
+    uint64_t cycles = pc->value[PERFCNT_CYCLES];
+    if (perfcnt_valid(pc, PERFCNT_CYCLES) &&
+        perfcnt_valid(pc, PERFCNT_INSTRUCTIONS) && cycles)
+        report(1, "IPC = %.2f",
+               (double) pc->value[PERFCNT_INSTRUCTIONS] / cycles);
+    for (int e = 0; e < PERFCNT_EVENTS; e++) {
+        if (!perfcnt_valid(pc, e))
+            continue;
+        if (elements > 0)
+            report(1, "%s = %" PRIu64 " (%.3f per element)", perfcnt_name(e),
+                   pc->value[e], (double) pc->value[e] / elements);
+        else
+            report(1, "%s = %" PRIu64, perfcnt_name(e), pc->value[e]);
+    }
+}
+
 static bool do_time(int argc, char *argv[])
 {
     double delta = delta_time(&last_time);
@@ -379,12 +506,24 @@ static bool do_time(int argc, char *argv[])
         double elapsed = last_time - first_time;
         report(1, "Elapsed time = %.3f, Delta time = %.3f", elapsed, delta);
     } else {
+        /* Elements may be added or removed, so count them before and after,
+         * and divide by the larger number
+         */
+        int elements = time_elements ? time_elements() : 0;
+        if (time_counters_open)
+            perfcnt_start(&time_counters);
         ok = interpret_cmda(argc - 1, argv + 1);
+        if (time_counters_open)
+            perfcnt_stop(&time_counters);
+        if (time_elements && time_elements() > elements)
+            elements = time_elements();
         if (block_flag) {
             block_timing = true;
         } else {
             delta = delta_time(&last_time);
-            report(1, "Delta time = %.3f", delta);
+            report(1, "Delta time = %.9f", delta);
+            if (time_counters_open)
+                report_perf(elements);
         }
     }
 
@@ -430,12 +569,22 @@ void init_cmd()
     ADD_COMMAND(log, "Copy output to file", "file");
     ADD_COMMAND(time, "Time command execution", "cmd arg ...");
     ADD_COMMAND(web, "Read commands from builtin web server", "[port]");
+    ADD_COMMAND(latency,
+                "Show the p50, p90, p99 and maximum latencies of the commands "
+                "run so far, or reset them",
+                "[reset]");
     add_cmd("#", do_comment_cmd, "Display comment", "...");
     add_param("simulation", &simulation, "Start/Stop simulation mode", NULL);
     add_param("verbose", &verblevel, "Verbosity level", NULL);
     add_param("error", &err_limit, "Number of errors until exit", NULL);
     add_param("echo", &echo, "Do/don't echo commands", NULL);
     add_param("entropy", &show_entropy, "Show/Hide Shannon entropy", NULL);
+    add_param("perf", &time_perf,
+              "Count cycles, instructions, cache and branch misses of the "
+              "commands run by time",
+              set_time_perf);
+    add_param("latency", &latency_on_quit,
+              "Show the latencies of the commands on quit", NULL);
 
     init_in();
     init_time(&last_time);
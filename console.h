@@ -24,6 +24,8 @@ typedef struct __cmd_element {
     cmd_func_t operation;
     char *summary;
     char *param;
+    /* Histogram of the execution times, allocated on the first execution */
+    struct latency *latency;
     struct __cmd_element *next;
 } cmd_element_t;
 
@@ -56,6 +58,18 @@ bool get_int(char *vname, int *loc);
 /* Add function to be executed as part of program exit */
 void add_quit_helper(cmd_func_t qf);
 
+/* Optionally supply functions invoked before and after each command line.
+ * A command run through "time" belongs to the "time" command line.
+ */
+typedef void (*cmd_hook_t)(int argc, char *argv[]);
+void set_cmd_hooks(cmd_hook_t before, cmd_hook_t after);
+
+/* Optionally supply function returning the number of elements the commands
+ * work on, for "time" to report hardware events per element
+ */
+typedef int (*elem_func_t)(void);
+void set_time_elements(elem_func_t f);
+
 /* Turn echoing on/off */
 void set_echo(bool on);
 
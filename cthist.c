@@ -0,0 +1,261 @@
+/* Histograms of the measurements of the constant time tests.
+ *
+ * Reads a trace written by the "cttrace" command of qtest, see
+ * dudect/trace.h, and shows for each operation the distribution of the
+ * ticks of both classes of inputs, side by side: an operation running in
+ * constant time has the same distribution in both.  The slowest 1% of the
+ * measurements, mostly interrupted ones, share the last bin.  With -c, it
+ * only checks the trace instead.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dudect/constant.h"
+#include "dudect/trace.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+#define MAX_BINS 100
+
+/* Width of the bar of the fullest bin */
+#define BAR_WIDTH 30
+
+static const char *names[] = {
+#define _(x) #x,
+    DUT_FUNCS
+#undef _
+};
+
+/* Ticks of the samples of an operation and a class, in ascending order */
+struct series {
+    int64_t *ticks;
+    size_t n;
+};
+
+static int cmp_ticks(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int64_t percentile(const struct series *s, double p)
+{
+    return s->ticks[(size_t) (p * (s->n - 1))];
+}
+
+static void summary(const struct series *s, int class)
+{
+    if (!s->n) {
+        printf("  class %d: no samples\n", class);
+        return;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < s->n; i++)
+        sum += s->ticks[i];
+    printf("  class %d: %zu samples, min %ld, median %ld, mean %.1f, "
+           "p99 %ld, max %ld\n",
+           class, s->n, (long) s->ticks[0], (long) percentile(s, 0.5),
+           sum / s->n, (long) percentile(s, 0.99),
+           (long) s->ticks[s->n - 1]);
+}
+
+static void bar(size_t count, size_t max)
+{
+    int width = max ? (int) ((double) count * BAR_WIDTH / max + 0.5) : 0;
+    printf(" %8zu %-*.*s", count, BAR_WIDTH, width,
+           "##############################");
+}
+
+static void histogram(const struct series s[2], int bins)
+{
+    int64_t lo = INT64_MAX, hi = 0;
+    for (int c = 0; c < 2; c++) {
+        if (!s[c].n)
+            continue;
+        if (s[c].ticks[0] < lo)
+            lo = s[c].ticks[0];
+        if (percentile(&s[c], 0.99) > hi)
+            hi = percentile(&s[c], 0.99);
+    }
+    int64_t width = (hi - lo) / bins + 1;
+
+    size_t count[2][MAX_BINS + 1] = {{0}};
+    size_t max = 0;
+    for (int c = 0; c < 2; c++) {
+        for (size_t i = 0; i < s[c].n; i++) {
+            int64_t b = (s[c].ticks[i] - lo) / width;
+            count[c][b < bins ? b : bins]++;
+        }
+        for (int b = 0; b <= bins; b++) {
+            /* Compare the shapes, whatever the samples of each class */
+            if (count[c][b] > max)
+                max = count[c][b];
+        }
+    }
+
+    printf("  %-19s %8s %-*s %8s\n", "ticks", "class 0", BAR_WIDTH, "",
+           "class 1");
+    for (int b = 0; b <= bins; b++) {
+        if (b < bins)
+            printf("  %8ld - %8ld", (long) (lo + b * width),
+                   (long) (lo + (b + 1) * width - 1));
+        else
+            printf("  %8s %8ld", ">=", (long) (lo + b * width));
+        bar(count[0][b], max);
+        bar(count[1][b], max);
+        printf("\n");
+    }
+}
+
+/* Check that a closed trace holds at least min samples, no more than its
+ * size, and only samples of known operations and classes
+ */
+static bool check(const struct ct_trace_header *h, off_t size, uint64_t min)
+{
+    const struct ct_sample *samples = (const struct ct_sample *) (h + 1);
+    uint64_t per_op[ARRAY_SIZE(names)] = {0};
+    bool ok = true;
+
+    if ((uint64_t) size != sizeof(*h) + h->count * sizeof(struct ct_sample)) {
+        printf("The size of the trace does not match its %lu samples\n",
+               (unsigned long) h->count);
+        ok = false;
+    }
+    if (h->count < min) {
+        printf("The trace holds %lu samples, fewer than %lu\n",
+               (unsigned long) h->count, (unsigned long) min);
+        ok = false;
+    }
+    for (uint64_t i = 0; i < h->count; i++) {
+        const struct ct_sample *x = &samples[i];
+        if (x->mode >= ARRAY_SIZE(names) || x->class > 1 || x->ticks <= 0 ||
+            x->reserved) {
+            printf("Sample %lu is invalid\n", (unsigned long) i);
+            return false;
+        }
+        per_op[x->mode]++;
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+        if (per_op[i])
+            printf("%s: %lu samples\n", names[i], (unsigned long) per_op[i]);
+    }
+    return ok;
+}
+
+static void usage(char *cmd)
+{
+    printf("Usage: %s [-h] [-b BINS] [-c MIN] FILE\n", cmd);
+    printf("\t-h         Print this information\n");
+    printf("\t-b BINS    Bins of the histograms, 1-%d (default: 20)\n",
+           MAX_BINS);
+    printf("\t-c MIN     Only check that the trace, once closed, holds at "
+           "least MIN\n\t           valid samples\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int bins = 20;
+    long min = -1;
+
+    int c;
+    while ((c = getopt(argc, argv, "hb:c:")) != -1) {
+        switch (c) {
+        case 'b':
+            bins = atoi(optarg);
+            break;
+        case 'c':
+            min = atol(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (bins < 1 || bins > MAX_BINS) {
+        fprintf(stderr, "Bins should be 1-%d\n", MAX_BINS);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(path);
+        return 1;
+    }
+    const struct ct_trace_header *h = NULL;
+    if (st.st_size >= (off_t) sizeof(*h))
+        h = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (!h || h == MAP_FAILED ||
+        memcmp(h->magic, CT_TRACE_MAGIC, sizeof(h->magic)) ||
+        h->version != CT_TRACE_VERSION ||
+        h->sample_size != sizeof(struct ct_sample) ||
+        h->count > (st.st_size - sizeof(*h)) / sizeof(struct ct_sample)) {
+        fprintf(stderr, "%s: not a trace of constant time tests\n", path);
+        return 1;
+    }
+    if (min >= 0) {
+        bool ok = check(h, st.st_size, min);
+        munmap((void *) h, st.st_size);
+        close(fd);
+        return ok ? 0 : 1;
+    }
+    const struct ct_sample *samples = (const struct ct_sample *) (h + 1);
+
+    struct series series[ARRAY_SIZE(names)][2] = {{{0}}};
+    for (int pass = 0; pass < 2; pass++) {
+        /* Count the samples of each series, then gather them */
+        for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+            for (int k = 0; k < 2; k++) {
+                struct series *s = &series[i][k];
+                if (pass && !(s->ticks = malloc(s->n * sizeof(int64_t) + 1))) {
+                    perror("malloc");
+                    return 1;
+                }
+                s->n = 0;
+            }
+        }
+        for (uint64_t i = 0; i < h->count; i++) {
+            const struct ct_sample *x = &samples[i];
+            if (x->mode >= ARRAY_SIZE(names) || x->class > 1)
+                continue;
+            struct series *s = &series[x->mode][x->class];
+            if (pass)
+                s->ticks[s->n] = x->ticks;
+            s->n++;
+        }
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+        struct series *s = series[i];
+        if (s[0].n || s[1].n) {
+            for (int k = 0; k < 2; k++)
+                qsort(s[k].ticks, s[k].n, sizeof(int64_t), cmp_ticks);
+            printf("%s\n", names[i]);
+            summary(&s[0], 0);
+            summary(&s[1], 1);
+            histogram(s, bins);
+            printf("\n");
+        }
+        free(s[0].ticks);
+        free(s[1].ticks);
+    }
+
+    munmap((void *) h, st.st_size);
+    close(fd);
+    return 0;
+}
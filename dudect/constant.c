@@ -7,156 +7,412 @@
 #include "queue.h"
 #include "random.h"
 
-/* Maintain a queue independent from the qtest since
+/* Maintain queues independent from the qtest since
  * we do not want the test to affect the original functionality
+ *
+ * Building a queue of up to 10000 elements for every single measurement used
+ * to take most of the time of a test.  Instead, a pool of queues is built
+ * once per test run, and every measurement picks one of them by its input.
+ * The queues of the random class are given new sizes, drawn at random, before
+ * every batch of measurements, by moving nodes between them and a list of
+ * spare nodes.  The measured operation is undone outside of the measurement,
+ * by relinking or releasing the node, so that the queue keeps its size for
+ * the following measurements.
+ *
+ * The pool and the strings are private to each thread, so that several
+ * threads may take measurements at the same time.
+ *
+ * The fenced timestamps of cpucycles.h tell apart operations differing by a
+ * couple of cycles, e.g. a store to one more cache line: both classes of
+ * inputs have to make the operation touch as many nodes, lying alike in
+ * memory.  Hence the fixed sizes of struct dut, and the nodes touched before
+ * every measurement.
  */
-static struct list_head *l = NULL;
+#define N_POOL 16
+#define N_FIXED 8
+#define MAX_POOL_SIZE 10000
 
-#define dut_new() ((void) (l = q_new()))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-#define dut_size(n)                                \
-    do {                                           \
-        for (int __iter = 0; __iter < n; ++__iter) \
-            q_size(l);                             \
-    } while (0)
+static __thread struct {
+    struct list_head *q;
+    int size;
+} pool[N_POOL];
 
-#define dut_insert_head(s, n)    \
-    do {                         \
-        int j = n;               \
-        while (j--)              \
-            q_insert_head(l, s); \
-    } while (0)
+/* Nodes of the queues of the random class beyond their current sizes */
+static __thread struct list_head *spare;
 
-#define dut_insert_tail(s, n)    \
-    do {                         \
-        int j = n;               \
-        while (j--)              \
-            q_insert_tail(l, s); \
-    } while (0)
+/* Mode the pool was built for, -1 if it is not built */
+static __thread int pool_mode = -1;
 
-#define dut_free() ((void) (q_free(l)))
+static __thread char random_string[N_MEASURES][8];
+static __thread int random_string_iter = 0;
 
-static char random_string[N_MEASURES][8];
-static int random_string_iter = 0;
+static char *get_random_string(void)
+{
+    random_string_iter = (random_string_iter + 1) % N_MEASURES;
+    return random_string[random_string_iter];
+}
+
+/**
+ * struct sample - State of a single measurement
+ * @l: queue the operation runs on
+ * @size: number of elements of the queue
+ * @first: first node of the queue before the operation
+ * @last: last node of the queue before the operation
+ * @second: node following @first
+ * @penult: node preceding @last
+ * @s: string to insert
+ * @fill: string the queue holds, to put back an element the operation frees
+ * @e: element inserted, removed or to release
+ * @ok: whether the operation succeeded
+ */
+struct sample {
+    struct list_head *l;
+    int size;
+    struct list_head *first, *last, *second, *penult;
+    char *s, *fill;
+    element_t *e;
+    bool ok;
+};
+
+/**
+ * struct dut - Operation under test
+ * @fixed_size: size of the queues of the fixed class, the smallest for which
+ *              the operation touches as many nodes as on larger queues
+ * @min_size: fewest elements of the queues of the random class
+ * @max_size: most elements of the queues of the random class
+ * @setup: prepare the measurement, not measured
+ * @run: the operation, measured
+ * @teardown: check the operation and undo it, not measured
+ */
+struct dut {
+    int fixed_size, min_size, max_size;
+    void (*setup)(struct sample *);
+    void (*run)(struct sample *);
+    bool (*teardown)(struct sample *);
+};
+
+static void setup_none(struct sample *s)
+{
+    (void) s;
+}
+
+static void setup_insert(struct sample *s)
+{
+    s->s = get_random_string();
+}
+
+static void run_insert_head(struct sample *s)
+{
+    s->ok = q_insert_head(s->l, s->s);
+}
+
+static void run_insert_tail(struct sample *s)
+{
+    s->ok = q_insert_tail(s->l, s->s);
+}
+
+/* Release the element an insertion added */
+static bool teardown_insert(struct list_head *node)
+{
+    element_t *e = list_entry(node, element_t, list);
+    list_del(node);
+    q_release_element(e);
+    return true;
+}
+
+static bool teardown_insert_head(struct sample *s)
+{
+    struct list_head *l = s->l;
+    if (!s->ok || l->next == s->first || l->next->next != s->first)
+        return false;
+    return teardown_insert(l->next);
+}
+
+static bool teardown_insert_tail(struct sample *s)
+{
+    struct list_head *l = s->l;
+    if (!s->ok || l->prev == s->last || l->prev->prev != s->last)
+        return false;
+    return teardown_insert(l->prev);
+}
+
+static void run_remove_head(struct sample *s)
+{
+    s->e = q_remove_head(s->l, NULL, 0);
+}
+
+static void run_remove_tail(struct sample *s)
+{
+    s->e = q_remove_tail(s->l, NULL, 0);
+}
+
+/* Link the removed element back, or drop whatever a failed removal gave */
+static bool teardown_remove_head(struct sample *s)
+{
+    bool ok = s->e && &s->e->list == s->first && s->l->next == s->second;
+    if (ok)
+        list_add(&s->e->list, s->l);
+    else if (s->e)
+        q_release_element(s->e);
+    return ok;
+}
+
+static bool teardown_remove_tail(struct sample *s)
+{
+    bool ok = s->e && &s->e->list == s->last && s->l->prev == s->penult;
+    if (ok)
+        list_add_tail(&s->e->list, s->l);
+    else if (s->e)
+        q_release_element(s->e);
+    return ok;
+}
+
+static void run_swap(struct sample *s)
+{
+    q_swap(s->l);
+}
+
+/* Swapping the pairs again puts every node back in place */
+static bool teardown_swap(struct sample *s)
+{
+    struct list_head *l = s->l;
+    bool ok = l->next == s->second && l->next->next == s->first;
+    q_swap(l);
+    return ok && l->next == s->first && l->prev == s->last;
+}
+
+static void run_delete_mid(struct sample *s)
+{
+    s->ok = q_delete_mid(s->l);
+}
+
+/* Any element holding the string of the queue may replace the deleted one */
+static bool teardown_delete_mid(struct sample *s)
+{
+    return s->ok && q_insert_head(s->l, s->fill);
+}
+
+static void setup_release_element(struct sample *s)
+{
+    s->e = q_remove_head(s->l, NULL, 0);
+}
+
+static void run_release_element(struct sample *s)
+{
+    q_release_element(s->e);
+}
+
+static bool teardown_release_element(struct sample *s)
+{
+    return s->e && q_insert_head(s->l, s->fill);
+}
+
+static const struct dut duts[] = {
+    [DUT(insert_head)] = {1, 1, MAX_POOL_SIZE - 1, setup_insert,
+                          run_insert_head, teardown_insert_head},
+    [DUT(insert_tail)] = {1, 1, MAX_POOL_SIZE - 1, setup_insert,
+                          run_insert_tail, teardown_insert_tail},
+    [DUT(remove_head)] = {2, 2, MAX_POOL_SIZE, setup_none, run_remove_head,
+                          teardown_remove_head},
+    [DUT(remove_tail)] = {2, 2, MAX_POOL_SIZE, setup_none, run_remove_tail,
+                          teardown_remove_tail},
+    [DUT(swap)] = {LINEAR_SIZE, LINEAR_SIZE, LINEAR_SIZE, setup_none, run_swap,
+                   teardown_swap},
+    [DUT(delete_mid)] = {LINEAR_SIZE, LINEAR_SIZE, LINEAR_SIZE, setup_none,
+                         run_delete_mid, teardown_delete_mid},
+    [DUT(release_element)] = {1, 1, MAX_POOL_SIZE, setup_release_element,
+                              run_release_element, teardown_release_element},
+};
 
 /* Implement the necessary queue interface to simulation */
+void free_dut(void)
+{
+    if (pool_mode < 0)
+        return;
+    for (int i = 0; i < N_POOL; i++)
+        q_free(pool[i].q);
+    q_free(spare);
+    pool_mode = -1;
+}
+
 void init_dut(void)
 {
-    l = NULL;
+    free_dut();
 }
 
-static char *get_random_string(void)
+/* The first N_FIXED queues, for the fixed class whose input is all zeros,
+ * have the fixed size of the operation, e.g. a single element for an
+ * insertion or two for a removal, and hold copies of the same string.  The
+ * other queues have random sizes and strings, of the same length so that
+ * they take the same allocations.  Both classes spread their measurements
+ * over as many queues, so that they see the caches in the same state.
+ */
+static char fixed_string[] = "aaaaaaa";
+static __thread char pool_random_string[sizeof(fixed_string)];
+
+static char *pool_string(int i)
 {
-    random_string_iter = (random_string_iter + 1) % N_MEASURES;
-    return random_string[random_string_iter];
+    if (i < N_FIXED)
+        return fixed_string;
+    random_lowercase(pool_random_string, sizeof(fixed_string) - 1);
+    return pool_random_string;
+}
+
+/* Move the first n nodes of a list to the end of another one */
+static void move_nodes(struct list_head *to, struct list_head *from, int n)
+{
+    if (!n)
+        return;
+    struct list_head *node = from;
+    for (int i = 0; i < n; i++)
+        node = node->next;
+    LIST_HEAD(cut);
+    list_cut_position(&cut, from, node);
+    list_splice_tail(&cut, to);
+}
+
+/* Draw new sizes for the queues of the random class.  The queues of the fixed
+ * class then trade their nodes for spare ones, so that the nodes of both
+ * classes come from the same population and lie alike in memory.
+ */
+static void redraw_sizes(const struct dut *dut)
+{
+    if (dut->min_size == dut->max_size)
+        return;
+    for (int i = N_FIXED; i < N_POOL; i++) {
+        uint16_t r = random_next();
+        int size = dut->min_size + r % (dut->max_size - dut->min_size + 1);
+        if (size < pool[i].size)
+            move_nodes(spare, pool[i].q, pool[i].size - size);
+        else
+            move_nodes(pool[i].q, spare, size - pool[i].size);
+        pool[i].size = size;
+    }
+    for (int i = 0; i < N_FIXED; i++) {
+        move_nodes(spare, pool[i].q, pool[i].size);
+        move_nodes(pool[i].q, spare, pool[i].size);
+    }
+}
+
+/* The queues of the random class are built at their largest size, which
+ * leaves enough nodes for any sizes redraw_sizes() may give them
+ */
+static bool build_pool(int mode)
+{
+    const struct dut *dut = &duts[mode];
+    spare = q_new();
+    if (!spare)
+        return false;
+    for (int i = 0; i < N_POOL; i++) {
+        pool[i].size = i < N_FIXED ? dut->fixed_size : dut->max_size;
+        pool[i].q = q_new();
+        if (!pool[i].q)
+            return false;
+    }
+
+    /* The queues grow in turn, so that their nodes are interleaved in memory
+     */
+    for (int j = 0; j < MAX(dut->fixed_size, dut->max_size); j++) {
+        for (int i = 0; i < N_POOL; i++) {
+            if (j < pool[i].size)
+                q_insert_head(pool[i].q, pool_string(i));
+        }
+    }
+    pool_mode = mode;
+    return true;
+}
+
+static int pool_index(const uint8_t *input, size_t i)
+{
+    uint16_t v = *(const uint16_t *) input;
+    return v ? N_FIXED + v % (N_POOL - N_FIXED) : i % N_FIXED;
 }
 
 void prepare_inputs(uint8_t *input_data, uint8_t *classes)
 {
-    randombytes(input_data, N_MEASURES * CHUNK_SIZE);
+    random_fill(input_data, N_MEASURES * CHUNK_SIZE);
+    random_fill(classes, N_MEASURES);
     for (size_t i = 0; i < N_MEASURES; i++) {
-        classes[i] = randombit();
+        classes[i] &= 1;
         if (classes[i] == 0)
             memset(input_data + (size_t) i * CHUNK_SIZE, 0, CHUNK_SIZE);
     }
 
-    for (size_t i = 0; i < N_MEASURES; ++i) {
-        /* Generate random string */
-        randombytes((uint8_t *) random_string[i], 7);
+    /* Generate random strings */
+    random_fill((uint8_t *) random_string, sizeof(random_string));
+    for (size_t i = 0; i < N_MEASURES; ++i)
         random_string[i][7] = 0;
+}
+
+/* Number of empty measurements taken to estimate the overhead */
+#define N_CALIBRATION 10000
+
+int64_t measure_overhead(void)
+{
+    int64_t overhead = INT64_MAX;
+    for (int i = 0; i < N_CALIBRATION; i++) {
+        int64_t before = cpucycles_start();
+        int64_t after = cpucycles_end();
+        if (after - before < overhead)
+            overhead = after - before;
     }
+    return overhead > 0 ? overhead : 0;
+}
+
+static inline void touch(const struct list_head *node)
+{
+    (void) *(struct list_head *volatile const *) &node->next;
 }
 
 bool measure(int64_t *before_ticks,
              int64_t *after_ticks,
+             uint32_t *sizes,
              uint8_t *input_data,
              int mode)
 {
-    assert(mode == DUT(insert_head) || mode == DUT(insert_tail) ||
-           mode == DUT(remove_head) || mode == DUT(remove_tail));
-
-    switch (mode) {
-    case DUT(insert_head):
-        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
-            char *s = get_random_string();
-            dut_new();
-            dut_insert_head(
-                get_random_string(),
-                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000);
-            int before_size = q_size(l);
-            before_ticks[i] = cpucycles();
-            dut_insert_head(s, 1);
-            after_ticks[i] = cpucycles();
-            int after_size = q_size(l);
-            dut_free();
-            if (before_size != after_size - 1)
-                return false;
-        }
-        break;
-    case DUT(insert_tail):
-        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
-            char *s = get_random_string();
-            dut_new();
-            dut_insert_head(
-                get_random_string(),
-                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000);
-            int before_size = q_size(l);
-            before_ticks[i] = cpucycles();
-            dut_insert_tail(s, 1);
-            after_ticks[i] = cpucycles();
-            int after_size = q_size(l);
-            dut_free();
-            if (before_size != after_size - 1)
-                return false;
-        }
-        break;
-    case DUT(remove_head):
-        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
-            dut_new();
-            dut_insert_head(
-                get_random_string(),
-                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000 + 1);
-            int before_size = q_size(l);
-            before_ticks[i] = cpucycles();
-            element_t *e = q_remove_head(l, NULL, 0);
-            after_ticks[i] = cpucycles();
-            int after_size = q_size(l);
-            if (e)
-                q_release_element(e);
-            dut_free();
-            if (before_size != after_size + 1)
-                return false;
-        }
-        break;
-    case DUT(remove_tail):
-        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
-            dut_new();
-            dut_insert_head(
-                get_random_string(),
-                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000 + 1);
-            int before_size = q_size(l);
-            before_ticks[i] = cpucycles();
-            element_t *e = q_remove_tail(l, NULL, 0);
-            after_ticks[i] = cpucycles();
-            int after_size = q_size(l);
-            if (e)
-                q_release_element(e);
-            dut_free();
-            if (before_size != after_size + 1)
-                return false;
-        }
-        break;
-    default:
-        for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
-            dut_new();
-            dut_insert_head(
-                get_random_string(),
-                *(uint16_t *) (input_data + i * CHUNK_SIZE) % 10000);
-            before_ticks[i] = cpucycles();
-            dut_size(1);
-            after_ticks[i] = cpucycles();
-            dut_free();
-        }
+    assert(mode >= 0 && mode < (int) (sizeof(duts) / sizeof(duts[0])));
+    const struct dut *dut = &duts[mode];
+
+    if (pool_mode != mode) {
+        free_dut();
+        if (!build_pool(mode))
+            return false;
+    }
+    redraw_sizes(dut);
+
+    for (size_t i = DROP_SIZE; i < N_MEASURES - DROP_SIZE; i++) {
+        int p = pool_index(input_data + i * CHUNK_SIZE, i);
+        struct list_head *l = pool[p].q;
+        struct sample s = {
+            .l = l,
+            .size = pool[p].size,
+            .first = l->next,
+            .last = l->prev,
+            .second = l->next->next,
+            .penult = l->prev->prev,
+            .fill = pool_string(p),
+        };
+
+        /* Both classes start from their nodes in the cache */
+        sizes[i] = s.size;
+        touch(s.first);
+        touch(s.second);
+        touch(s.penult);
+        touch(s.last);
+        dut->setup(&s);
+        before_ticks[i] = cpucycles_start();
+        dut->run(&s);
+        after_ticks[i] = cpucycles_end();
+        if (!dut->teardown(&s))
+            return false;
+    }
+
+    /* Every queue must be back to its size */
+    for (int i = 0; i < N_POOL; i++) {
+        if (q_size(pool[i].q) != pool[i].size)
+            return false;
     }
     return true;
 }
@@ -12,11 +12,22 @@
 
 #define DROP_SIZE 20
 
+/* Operations walking the queue cannot take the same time on queues of
+ * different sizes.  They run on queues of this size in both classes, which
+ * differ by the strings they hold, so that their time is checked not to
+ * depend on the contents of the queue; how it grows with the size is left to
+ * the complexity command.
+ */
+#define LINEAR_SIZE 1000
+
 #define DUT_FUNCS  \
     _(insert_head) \
     _(insert_tail) \
     _(remove_head) \
-    _(remove_tail)
+    _(remove_tail) \
+    _(swap)        \
+    _(delete_mid)  \
+    _(release_element)
 
 #define DUT(x) DUT_##x
 
@@ -27,9 +38,20 @@ enum {
 };
 
 void init_dut();
+void free_dut();
 void prepare_inputs(uint8_t *input_data, uint8_t *classes);
+
+/* Fewest ticks an empty measurement takes, which every measurement adds to
+ * the time of the operation
+ */
+int64_t measure_overhead(void);
+
+/* Take a batch of measurements of an operation.  The size of the queue of
+ * each measurement goes to sizes.
+ */
 bool measure(int64_t *before_ticks,
              int64_t *after_ticks,
+             uint32_t *sizes,
              uint8_t *input_data,
              int mode);
 
@@ -2,13 +2,29 @@
 #define DUDECT_CPUCYCLES_H
 
 #include <stdint.h>
+#include <time.h>
+
+/* Timestamps around a measured operation.
+ *
+ * The counter is read between fences, so that the operation can neither
+ * start before cpucycles_start() has read it nor still be running when
+ * cpucycles_end() reads it.  Architectures without a known counter fall
+ * back to the monotonic clock, in nanoseconds.
+ */
 
 // http://www.intel.com/content/www/us/en/embedded/training/ia-32-ia-64-benchmark-code-execution-paper.html
-static inline int64_t cpucycles(void)
+
+/* Read the counter once every earlier instruction has completed, and before
+ * any later one starts
+ */
+static inline int64_t cpucycles_start(void)
 {
 #if defined(__i386__) || defined(__x86_64__)
     unsigned int hi, lo;
-    __asm__ volatile("rdtsc\n\t" : "=a"(lo), "=d"(hi));
+    __asm__ volatile("lfence\n\trdtsc\n\tlfence\n\t"
+                     : "=a"(lo), "=d"(hi)
+                     :
+                     : "memory");
     return ((int64_t) lo) | (((int64_t) hi) << 32);
 
 #elif defined(__aarch64__)
@@ -19,10 +35,37 @@ static inline int64_t cpucycles(void)
      * bits wide and it is attributed with the flag 'cap_user_time_short'
      * is true.
      */
-    asm volatile("mrs %0, cntvct_el0" : "=r"(val));
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(val) : : "memory");
+    return val;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* Read the counter once the measured instructions have completed.  rdtscp
+ * waits for them, and the following lfence keeps later instructions from
+ * starting before the read.
+ */
+static inline int64_t cpucycles_end(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int hi, lo;
+    __asm__ volatile("rdtscp\n\tlfence\n\t"
+                     : "=a"(lo), "=d"(hi)
+                     :
+                     : "ecx", "memory");
+    return ((int64_t) lo) | (((int64_t) hi) << 32);
+
+#elif defined(__aarch64__)
+    uint64_t val;
+    asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(val) : : "memory");
     return val;
 #else
-#error Unsupported Architecture
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
 #endif
 }
 
@@ -24,10 +24,27 @@
  *
  *  - as long as any of the different test fails, the code will be deemed
  *    variable time.
+ *
+ *  - the measurements may be shared among several threads, each pinned to a
+ *    CPU of its own and keeping its own statistics, which are merged at the
+ *    end. Running on isolated CPUs keeps the scheduler from interrupting the
+ *    measurements.
+ *
+ *  - the statistics of a test may be kept in a file, which later runs
+ *    continue from and which the files of other processes may be merged
+ *    into, so that a long campaign of measurements can be interrupted or
+ *    spread over several machines.
+ *
+ *  - every measurement may also be appended to a trace file, see trace.h.
  */
 
+#define _GNU_SOURCE
 #include <assert.h>
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,15 +53,51 @@
 #include "../console.h"
 #include "../random.h"
 
+/* The measurements use the regular malloc/free */
+#define INTERNAL 1
+#include "../harness.h"
+
 #include "constant.h"
 #include "fixture.h"
+#include "trace.h"
 #include "ttest.h"
 
 #define ENOUGH_MEASURE 10000
 #define TEST_TRIES 10
 
+/* Number of percentiles the measurements are cropped at */
+#define N_PERCENTILES 100
+
+/* The t-tests of a run: on the raw measurements, on the measurements below
+ * each of the percentiles, and the second order test
+ */
+#define N_TESTS (N_PERCENTILES + 2)
+#define TEST_RAW 0
+#define TEST_CROPPED(i) (1 + (i))
+#define TEST_SECOND_ORDER (N_PERCENTILES + 1)
+
+/* A cropped or second order test takes part in the verdict once it has this
+ * many measurements; fewer would make it too noisy
+ */
+#define ENOUGH_MEASURE_TEST (ENOUGH_MEASURE / 2)
+
+/* The second order test starts once the means are known this well */
+#define SECOND_ORDER_START (ENOUGH_MEASURE / 10)
+
+/* Number of batches of measurements of a try, besides the first one */
+#define N_BATCHES (ENOUGH_MEASURE / (N_MEASURES - DROP_SIZE * 2) + 1)
+
+int dudect_workers = 1;
+
 static t_context_t *t;
 
+/* Ticks of an empty measurement, -1 until they are measured */
+static int64_t overhead = -1;
+
+/* Cropping thresholds, taken from the first batch of measurements of a run */
+static int64_t percentiles[N_PERCENTILES];
+static bool have_percentiles;
+
 /* threshold values for Welch's t-test */
 enum {
     t_threshold_bananas = 500, /* Test failed with overwhelming probability */
@@ -56,15 +109,57 @@ static void __attribute__((noreturn)) die(void)
     exit(111);
 }
 
+/* Ticks of the operation itself, without those of the measurement.  A
+ * dropped measurement or an overflowed counter keeps a difference of zero
+ * or less, to be skipped; any other one lasts at least a tick.
+ */
 static void differentiate(int64_t *exec_times,
                           const int64_t *before_ticks,
                           const int64_t *after_ticks)
 {
-    for (size_t i = 0; i < N_MEASURES; i++)
-        exec_times[i] = after_ticks[i] - before_ticks[i];
+    for (size_t i = 0; i < N_MEASURES; i++) {
+        int64_t difference = after_ticks[i] - before_ticks[i];
+        if (difference > overhead)
+            difference -= overhead;
+        else if (difference > 0)
+            difference = 1;
+        exec_times[i] = difference;
+    }
+}
+
+static int cmp_ticks(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* Set the cropping thresholds to percentiles of the valid measurements,
+ * closer and closer to the slowest one: the first test keeps about the
+ * fastest 7% of the measurements, the last one nearly all of them.
+ */
+static void prepare_percentiles(const int64_t *exec_times)
+{
+    int64_t sorted[N_MEASURES];
+    size_t n = 0;
+
+    for (size_t i = 0; i < N_MEASURES; i++) {
+        if (exec_times[i] > 0)
+            sorted[n++] = exec_times[i];
+    }
+    if (!n)
+        return;
+    qsort(sorted, n, sizeof(sorted[0]), cmp_ticks);
+
+    for (size_t i = 0; i < N_PERCENTILES; i++) {
+        double which = 1 - pow(0.5, 10 * (double) (i + 1) / N_PERCENTILES);
+        percentiles[i] = sorted[(size_t) (which * n)];
+    }
+    have_percentiles = true;
 }
 
-static void update_statistics(const int64_t *exec_times, uint8_t *classes)
+static void update_statistics(const int64_t *exec_times,
+                              uint8_t *classes,
+                              t_context_t *tests)
 {
     for (size_t i = 0; i < N_MEASURES; i++) {
         int64_t difference = exec_times[i];
@@ -73,24 +168,116 @@ static void update_statistics(const int64_t *exec_times, uint8_t *classes)
             continue;
 
         /* do a t-test on the execution time */
-        t_push(t, difference, classes[i]);
+        t_push(&tests[TEST_RAW], difference, classes[i]);
+
+        /* do a t-test on the execution time below each threshold */
+        for (size_t p = 0; p < N_PERCENTILES; p++) {
+            if (difference < percentiles[p])
+                t_push(&tests[TEST_CROPPED(p)], difference, classes[i]);
+        }
+
+        /* do a second order test on the centered squares, each worker
+         * starting once it has its share of the measurements
+         */
+        t_context_t *raw = &tests[TEST_RAW];
+        if (raw->n[0] + raw->n[1] > SECOND_ORDER_START / dudect_workers) {
+            double centered = difference - raw->mean[classes[i]];
+            t_push(&tests[TEST_SECOND_ORDER], centered * centered,
+                   classes[i]);
+        }
+    }
+}
+
+/* The test with the largest t among those with enough measurements */
+static t_context_t *max_test(void)
+{
+    t_context_t *max = &t[TEST_RAW];
+    double max_t = fabs(t_compute(max));
+
+    for (size_t i = 1; i < N_TESTS; i++) {
+        if (t[i].n[0] + t[i].n[1] < ENOUGH_MEASURE_TEST ||
+            t[i].n[0] < 2 || t[i].n[1] < 2)
+            continue;
+        double x = fabs(t_compute(&t[i]));
+        if (x > max_t) {
+            max_t = x;
+            max = &t[i];
+        }
     }
+    return max;
+}
+
+/* Name and try of the test being run, for the statistics streamed */
+static const char *current_op;
+static int current_try;
+
+/* File the statistics are streamed to, every stream_every measurements */
+static FILE *stream_file;
+static int stream_every;
+static double streamed;
+
+static void stream_number(const char *name, double x)
+{
+    if (isfinite(x))
+        fprintf(stream_file, ",\"%s\":%.6g", name, x);
+    else
+        fprintf(stream_file, ",\"%s\":null", name);
+}
+
+/* Append a JSON object with the t statistics to the stream, once the raw
+ * test has stream_every more measurements than when it was last appended
+ */
+static void stream_stats(void)
+{
+    double n = t[TEST_RAW].n[0] + t[TEST_RAW].n[1];
+    if (!stream_file || t[TEST_RAW].n[0] < 2 || t[TEST_RAW].n[1] < 2 ||
+        (int64_t) (n / stream_every) == (int64_t) (streamed / stream_every))
+        return;
+    streamed = n;
+
+    t_context_t *test = max_test();
+    double max_t = fabs(t_compute(test));
+    fprintf(stream_file, "{\"op\":\"%s\",\"try\":%d,\"measurements\":%.0f",
+            current_op, current_try, n);
+    stream_number("max_t", max_t);
+    stream_number("max_tau", max_t / sqrt(test->n[0] + test->n[1]));
+    stream_number("t_raw", t_compute(&t[TEST_RAW]));
+    stream_number("t_second_order", t_compute(&t[TEST_SECOND_ORDER]));
+    fprintf(stream_file, "}\n");
+    fflush(stream_file);
+}
+
+bool dudect_set_stream(const char *path, int every)
+{
+    if (stream_file)
+        fclose(stream_file);
+    stream_file = NULL;
+    if (!path)
+        return true;
+    stream_file = fopen(path, "a");
+    stream_every = every;
+    return stream_file;
 }
 
 static bool report(void)
 {
-    double max_t = fabs(t_compute(t));
-    double number_traces_max_t = t->n[0] + t->n[1];
-    double max_tau = max_t / sqrt(number_traces_max_t);
+    double number_traces = t[TEST_RAW].n[0] + t[TEST_RAW].n[1];
 
     printf("\033[A\033[2K");
-    printf("meas: %7.2lf M, ", (number_traces_max_t / 1e6));
-    if (number_traces_max_t < ENOUGH_MEASURE) {
+    if (number_traces < ENOUGH_MEASURE) {
+        printf("meas: %7.2lf M, ", (number_traces / 1e6));
         printf("not enough measurements (%.0f still to go).\n",
-               ENOUGH_MEASURE - number_traces_max_t);
+               ENOUGH_MEASURE - number_traces);
         return false;
     }
 
+    t_context_t *test = max_test();
+    double max_t = fabs(t_compute(test));
+    double number_traces_max_t = test->n[0] + test->n[1];
+    double max_tau = max_t / sqrt(number_traces_max_t);
+
+    printf("meas: %7.2lf M, ", (number_traces_max_t / 1e6));
+
     /* max_t: the t statistic value
      * max_tau: a t value normalized by sqrt(number of measurements).
      *          this way we can compare max_tau taken with different
@@ -116,56 +303,418 @@ static bool report(void)
     return true;
 }
 
-static bool doit(int mode)
+/* Take a batch of measurements and add them to the tests, or set the
+ * cropping thresholds with it if they are not set yet
+ */
+static bool measure_batch(int mode, t_context_t *tests)
 {
     int64_t *before_ticks = calloc(N_MEASURES + 1, sizeof(int64_t));
     int64_t *after_ticks = calloc(N_MEASURES + 1, sizeof(int64_t));
     int64_t *exec_times = calloc(N_MEASURES, sizeof(int64_t));
+    uint32_t *sizes = calloc(N_MEASURES, sizeof(uint32_t));
     uint8_t *classes = calloc(N_MEASURES, sizeof(uint8_t));
     uint8_t *input_data = calloc(N_MEASURES * CHUNK_SIZE, sizeof(uint8_t));
 
-    if (!before_ticks || !after_ticks || !exec_times || !classes ||
+    if (!before_ticks || !after_ticks || !exec_times || !sizes || !classes ||
         !input_data) {
         die();
     }
 
     prepare_inputs(input_data, classes);
 
-    bool ret = measure(before_ticks, after_ticks, input_data, mode);
+    bool ret = measure(before_ticks, after_ticks, sizes, input_data, mode);
     differentiate(exec_times, before_ticks, after_ticks);
-    update_statistics(exec_times, classes);
-    ret &= report();
+    if (!ct_trace_append(mode, exec_times + DROP_SIZE, classes + DROP_SIZE,
+                         sizes + DROP_SIZE, N_MEASURES - DROP_SIZE * 2))
+        printf("Cannot append to the trace, which is closed\n");
+    if (have_percentiles)
+        update_statistics(exec_times, classes, tests);
+    else
+        prepare_percentiles(exec_times);
 
     free(before_ticks);
     free(after_ticks);
     free(exec_times);
+    free(sizes);
     free(classes);
     free(input_data);
 
     return ret;
 }
 
-static void init_once(void)
+static bool doit(int mode)
+{
+    bool ret = measure_batch(mode, t);
+    stream_stats();
+    ret &= report();
+    return ret;
+}
+
+/**
+ * struct worker - Thread taking a share of the measurements of a try
+ * @thread: the thread
+ * @cpu: CPU the thread is pinned to
+ * @mode: operation under test
+ * @batches: number of batches of measurements to take
+ * @ok: whether the operation behaved correctly in every batch
+ * @t: statistics of the measurements of the thread
+ */
+struct worker {
+    pthread_t thread;
+    int cpu;
+    int mode;
+    int batches;
+    bool ok;
+    t_context_t t[N_TESTS];
+};
+
+static void *worker_run(void *arg)
+{
+    struct worker *w = arg;
+
+    /* The time limit alarm is for the thread running the interpreter */
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(w->cpu, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+
+    /* An exception raised while measuring, e.g. by the harness, unwinds to
+     * this thread and fails its batch
+     */
+    init_dut();
+    for (int i = 0; w->ok && i < w->batches; i++) {
+        if (exception_setup(false))
+            w->ok = measure_batch(w->mode, w->t);
+        else
+            w->ok = false;
+        exception_cancel();
+    }
+    if (exception_setup(false))
+        free_dut();
+    exception_cancel();
+    return NULL;
+}
+
+int dudect_max_workers(void)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+        return 1;
+    return CPU_COUNT(&allowed);
+}
+
+/* Share the batches of a try among the workers, one on each of the CPUs the
+ * process may run on, then merge their statistics.  The cropping thresholds
+ * are taken beforehand, for all the workers to use the same ones.
+ */
+static bool doit_parallel(int mode)
+{
+    struct worker *workers = calloc(dudect_workers, sizeof(struct worker));
+    cpu_set_t allowed;
+    if (!workers || sched_getaffinity(0, sizeof(allowed), &allowed))
+        die();
+
+    bool ret = measure_batch(mode, t);
+    free_dut();
+
+    int cpu = 0;
+    for (int i = 0; i < dudect_workers; i++) {
+        struct worker *w = &workers[i];
+        while (cpu < CPU_SETSIZE - 1 && !CPU_ISSET(cpu, &allowed))
+            cpu++;
+        w->cpu = cpu++;
+        w->mode = mode;
+        w->batches = N_BATCHES / dudect_workers;
+        if (i < N_BATCHES % dudect_workers)
+            w->batches++;
+        w->ok = true;
+        for (size_t j = 0; j < N_TESTS; j++)
+            t_init(&w->t[j]);
+        if (pthread_create(&w->thread, NULL, worker_run, w))
+            die();
+    }
+
+    for (int i = 0; i < dudect_workers; i++) {
+        struct worker *w = &workers[i];
+        pthread_join(w->thread, NULL);
+        ret &= w->ok;
+        for (size_t j = 0; j < N_TESTS; j++)
+            t_merge(&t[j], &w->t[j]);
+    }
+    free(workers);
+
+    stream_stats();
+    ret &= report();
+    return ret;
+}
+
+/* The statistics of the tests may be kept in a file, holding a record for
+ * each operation tested: a header, the cropping thresholds, then the tests.
+ * The tries of a test start from the record of its operation, if any,
+ * instead of from nothing, and the last one stores its statistics back into
+ * the file.
+ */
+#define STATE_MAGIC "dudect1"
+
+struct state_header {
+    char magic[8];
+    char op[24];
+    uint32_t n_percentiles;
+    uint32_t n_tests;
+};
+
+static char *state_path;
+
+/* Read the next record of a file.
+ *
+ * Return: 1 if there was one, 0 at the end of the file, -1 if the file holds
+ * anything else
+ */
+static int read_record(FILE *f,
+                       struct state_header *h,
+                       int64_t *thresholds,
+                       t_context_t *tests)
+{
+    size_t n = fread(h, 1, sizeof(*h), f);
+    if (n == 0 && feof(f))
+        return 0;
+    if (n != sizeof(*h) || memcmp(h->magic, STATE_MAGIC, sizeof(h->magic)) ||
+        h->n_percentiles != N_PERCENTILES || h->n_tests != N_TESTS ||
+        !memchr(h->op, '\0', sizeof(h->op)))
+        return -1;
+    if (fread(thresholds, sizeof(*thresholds), N_PERCENTILES, f) !=
+            N_PERCENTILES ||
+        !t_load(tests, N_TESTS, f))
+        return -1;
+    return 1;
+}
+
+static bool write_record(FILE *f,
+                         const char *op,
+                         const int64_t *thresholds,
+                         const t_context_t *tests)
+{
+    struct state_header h = {
+        .magic = STATE_MAGIC,
+        .n_percentiles = N_PERCENTILES,
+        .n_tests = N_TESTS,
+    };
+    strncpy(h.op, op, sizeof(h.op) - 1);
+    return fwrite(&h, sizeof(h), 1, f) == 1 &&
+           fwrite(thresholds, sizeof(*thresholds), N_PERCENTILES, f) ==
+               N_PERCENTILES &&
+           t_save(tests, N_TESTS, f);
+}
+
+/* Find the record of an operation in a file.
+ *
+ * Return: 1 if it was found, 0 if the file has none or does not exist, -1 if
+ * the file cannot be read
+ */
+static int find_record(const char *path,
+                       const char *op,
+                       int64_t *thresholds,
+                       t_context_t *tests)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+
+    struct state_header h;
+    int found;
+    while ((found = read_record(f, &h, thresholds, tests)) > 0 &&
+           strcmp(h.op, op))
+        ;
+    fclose(f);
+    return found;
+}
+
+/* Replace the record of an operation in a file, or add it.  The file is
+ * rewritten aside and renamed, so that it is never left half written.
+ */
+static bool store_record(const char *path,
+                         const char *op,
+                         const int64_t *thresholds,
+                         const t_context_t *tests)
+{
+    size_t len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = malloc(len);
+    int64_t *other_thresholds = calloc(N_PERCENTILES, sizeof(int64_t));
+    t_context_t *other = calloc(N_TESTS, sizeof(t_context_t));
+    if (!tmp_path || !other_thresholds || !other)
+        die();
+    snprintf(tmp_path, len, "%s.tmp", path);
+
+    bool ok = false;
+    FILE *in = fopen(path, "rb");
+    FILE *out = fopen(tmp_path, "wb");
+    if (out) {
+        struct state_header h;
+        int r = 0;
+        while (in && (r = read_record(in, &h, other_thresholds, other)) > 0) {
+            if (strcmp(h.op, op) &&
+                !write_record(out, h.op, other_thresholds, other))
+                break;
+        }
+        ok = r == 0 && write_record(out, op, thresholds, tests);
+        ok &= !fclose(out);
+        if (ok)
+            ok = !rename(tmp_path, path);
+        else
+            remove(tmp_path);
+    }
+    if (in)
+        fclose(in);
+
+    free(tmp_path);
+    free(other_thresholds);
+    free(other);
+    return ok;
+}
+
+/* Check that every record of a file can be read */
+static bool check_state(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return errno == ENOENT;
+
+    struct state_header h;
+    int64_t *thresholds = calloc(N_PERCENTILES, sizeof(int64_t));
+    t_context_t *tests = calloc(N_TESTS, sizeof(t_context_t));
+    if (!thresholds || !tests)
+        die();
+    int r;
+    while ((r = read_record(f, &h, thresholds, tests)) > 0)
+        ;
+    fclose(f);
+    free(thresholds);
+    free(tests);
+    return r == 0;
+}
+
+bool dudect_set_state(const char *path)
+{
+    free(state_path);
+    state_path = NULL;
+    if (!path)
+        return true;
+    if (!check_state(path))
+        return false;
+    state_path = strdup(path);
+    return state_path;
+}
+
+/* The statistics of a cropped test are only meaningful together with those
+ * of a test cropped at the same threshold.  Records whose thresholds differ
+ * only have their raw and second order tests merged.
+ */
+int dudect_merge_state(const char *path, bool *partial)
+{
+    if (!state_path || !check_state(path))
+        return -1;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return -1;
+
+    struct state_header h;
+    int64_t *thresholds = calloc(N_PERCENTILES * 2, sizeof(int64_t));
+    t_context_t *tests = calloc(N_TESTS * 2, sizeof(t_context_t));
+    if (!thresholds || !tests)
+        die();
+    int64_t *into_thresholds = thresholds + N_PERCENTILES;
+    t_context_t *into = tests + N_TESTS;
+
+    int merged = 0, r;
+    *partial = false;
+    while ((r = read_record(f, &h, thresholds, tests)) > 0) {
+        int found = find_record(state_path, h.op, into_thresholds, into);
+        if (found < 0)
+            break;
+        if (!found) {
+            memcpy(into_thresholds, thresholds,
+                   N_PERCENTILES * sizeof(int64_t));
+            for (size_t i = 0; i < N_TESTS; i++)
+                t_init(&into[i]);
+        }
+        bool same = !memcmp(into_thresholds, thresholds,
+                            N_PERCENTILES * sizeof(int64_t));
+        for (size_t i = 0; i < N_TESTS; i++) {
+            if (same || i == TEST_RAW || i == TEST_SECOND_ORDER)
+                t_merge(&into[i], &tests[i]);
+        }
+        *partial |= !same;
+        if (!store_record(state_path, h.op, into_thresholds, into))
+            break;
+        merged++;
+    }
+    fclose(f);
+    free(thresholds);
+    free(tests);
+    return r == 0 ? merged : -1;
+}
+
+/* Start a try from the statistics saved for its operation, or from nothing
+ * if thresholds is NULL
+ */
+static void init_once(const int64_t *thresholds, const t_context_t *saved)
 {
     init_dut();
-    t_init(t);
+    have_percentiles = thresholds != NULL;
+    if (have_percentiles) {
+        memcpy(percentiles, thresholds, sizeof(percentiles));
+        memcpy(t, saved, N_TESTS * sizeof(t_context_t));
+    } else {
+        for (size_t i = 0; i < N_TESTS; i++)
+            t_init(&t[i]);
+    }
+    streamed = t[TEST_RAW].n[0] + t[TEST_RAW].n[1];
 }
 
 static bool test_const(char *text, int mode)
 {
     bool result = false;
-    t = malloc(sizeof(t_context_t));
+    t = malloc(sizeof(t_context_t) * N_TESTS);
+    if (overhead < 0)
+        overhead = measure_overhead();
+
+    /* Every try starts from the record as it was before the first one, so
+     * that a failed try is not carried into the next; only the last one is
+     * saved.
+     */
+    int64_t saved_percentiles[N_PERCENTILES];
+    t_context_t *saved = malloc(sizeof(t_context_t) * N_TESTS);
+    if (!t || !saved)
+        die();
+    bool have_saved = state_path && find_record(state_path, text,
+                                                saved_percentiles, saved) > 0;
 
+    current_op = text;
     for (int cnt = 0; cnt < TEST_TRIES; ++cnt) {
         printf("Testing %s...(%d/%d)\n\n", text, cnt, TEST_TRIES);
-        init_once();
-        for (int i = 0; i < ENOUGH_MEASURE / (N_MEASURES - DROP_SIZE * 2) + 1;
-             ++i)
-            result = doit(mode);
+        current_try = cnt;
+        init_once(have_saved ? saved_percentiles : NULL, saved);
+        if (dudect_workers > 1) {
+            result = doit_parallel(mode);
+        } else {
+            /* One more batch than needed, to set the cropping thresholds */
+            for (int i = 0; i < N_BATCHES + 1; ++i)
+                result = doit(mode);
+        }
         printf("\033[A\033[2K\033[A\033[2K");
         if (result)
             break;
     }
+    if (state_path && have_percentiles &&
+        !store_record(state_path, text, percentiles, t))
+        printf("Cannot save the statistics to %s\n", state_path);
+    free_dut();
+    free(saved);
     free(t);
     return result;
 }
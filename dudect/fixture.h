@@ -4,6 +4,36 @@
 #include <stdbool.h>
 #include "constant.h"
 
+/* Number of threads taking the measurements, each on a CPU of its own */
+extern int dudect_workers;
+
+/* Number of CPUs the process may run on, hence the most workers */
+int dudect_max_workers(void);
+
+/* Keep the statistics of the tests in the file at path, or in no file if path
+ * is NULL.  Every try of a test continues from the statistics of its
+ * operation in the file, and saves them back once it is over.
+ *
+ * Return: false if the file holds anything but statistics
+ */
+bool dudect_set_state(const char *path);
+
+/* Add the statistics of the file at path to those of the file set by
+ * dudect_set_state().  *partial tells whether some cropped tests were left
+ * out, as they were cropped at other thresholds.
+ *
+ * Return: the number of operations merged, or -1 if a file could not be read
+ * or written
+ */
+int dudect_merge_state(const char *path, bool *partial);
+
+/* Append the t statistics of the tests to the file at path, as a JSON object
+ * on a line of its own, every `every` measurements, or stop if path is NULL.
+ *
+ * Return: false if the file could not be opened
+ */
+bool dudect_set_stream(const char *path, int every);
+
 /* Interface to test if function is constant */
 #define _(x) bool is_##x##_const(void);
 DUT_FUNCS
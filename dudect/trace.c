@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/* Samples the file grows by at least, 1 MiB */
+#define GROW_SAMPLES 65536
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static int trace_fd = -1;
+static struct ct_trace_header *trace_map;
+static size_t trace_capacity;
+
+static size_t map_size(size_t samples)
+{
+    return sizeof(struct ct_trace_header) + samples * sizeof(struct ct_sample);
+}
+
+static struct ct_sample *samples(void)
+{
+    return (struct ct_sample *) (trace_map + 1);
+}
+
+/* Grow the file and its mapping to hold at least capacity samples */
+static bool grow(size_t capacity)
+{
+    if (capacity < trace_capacity * 2)
+        capacity = trace_capacity * 2;
+    if (capacity < GROW_SAMPLES)
+        capacity = GROW_SAMPLES;
+    if (ftruncate(trace_fd, map_size(capacity)))
+        return false;
+
+    void *map = mremap(trace_map, map_size(trace_capacity), map_size(capacity),
+                       MREMAP_MAYMOVE);
+    if (map == MAP_FAILED)
+        return false;
+    trace_map = map;
+    trace_capacity = capacity;
+    return true;
+}
+
+static void close_locked(void)
+{
+    if (!trace_map)
+        return;
+    size_t size = map_size(trace_map->count);
+    munmap(trace_map, map_size(trace_capacity));
+    /* Should the spare room stay, the header still tells the samples */
+    ftruncate(trace_fd, size);
+    close(trace_fd);
+    trace_map = NULL;
+    trace_fd = -1;
+}
+
+void ct_trace_close(void)
+{
+    pthread_mutex_lock(&trace_lock);
+    close_locked();
+    pthread_mutex_unlock(&trace_lock);
+}
+
+bool ct_trace_open(const char *path)
+{
+    ct_trace_close();
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) ||
+        (!st.st_size && ftruncate(fd, map_size(GROW_SAMPLES))) ||
+        (st.st_size && st.st_size < (off_t) map_size(0))) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size ? st.st_size : map_size(GROW_SAMPLES);
+
+    struct ct_trace_header *map =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    size_t capacity = (size - map_size(0)) / sizeof(struct ct_sample);
+    if (!st.st_size) {
+        memcpy(map->magic, CT_TRACE_MAGIC, sizeof(map->magic));
+        map->version = CT_TRACE_VERSION;
+        map->sample_size = sizeof(struct ct_sample);
+        map->count = 0;
+    } else if (memcmp(map->magic, CT_TRACE_MAGIC, sizeof(map->magic)) ||
+               map->version != CT_TRACE_VERSION ||
+               map->sample_size != sizeof(struct ct_sample) ||
+               map->count > capacity) {
+        munmap(map, size);
+        close(fd);
+        return false;
+    }
+
+    pthread_mutex_lock(&trace_lock);
+    trace_fd = fd;
+    trace_map = map;
+    trace_capacity = capacity;
+    pthread_mutex_unlock(&trace_lock);
+    return true;
+}
+
+bool ct_trace_append(int mode,
+                     const int64_t *ticks,
+                     const uint8_t *classes,
+                     const uint32_t *sizes,
+                     size_t count)
+{
+    bool ok = true;
+    pthread_mutex_lock(&trace_lock);
+    if (!trace_map)
+        goto out;
+
+    if (trace_map->count + count > trace_capacity &&
+        !grow(trace_map->count + count)) {
+        close_locked();
+        ok = false;
+        goto out;
+    }
+
+    struct ct_sample *s = samples() + trace_map->count;
+    for (size_t i = 0; i < count; i++) {
+        /* Dropped measurement or overflowed counter */
+        if (ticks[i] <= 0)
+            continue;
+        *s++ = (struct ct_sample){
+            .ticks = ticks[i],
+            .size = sizes[i],
+            .mode = mode,
+            .class = classes[i],
+        };
+    }
+    trace_map->count = s - samples();
+
+out:
+    pthread_mutex_unlock(&trace_lock);
+    return ok;
+}
@@ -0,0 +1,85 @@
+#ifndef DUDECT_TRACE_H
+#define DUDECT_TRACE_H
+
+/* Raw measurements of the constant time tests.
+ *
+ * The tests only keep statistics of their measurements.  To look at the
+ * measurements themselves, e.g. at the distribution of the times of each
+ * class, they may be appended to a trace file as they are taken.  The file
+ * is mapped in memory and grown as needed, so that appending a batch is a
+ * copy into the mapping, and holds a header followed by the samples.  The
+ * count of the header is only increased once the samples are written: a
+ * file whose writer died still holds that many valid samples.
+ *
+ * cthist reads a trace and shows the histograms of the classes of each
+ * operation.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CT_TRACE_MAGIC "cttrace"
+#define CT_TRACE_VERSION 1
+
+/**
+ * struct ct_trace_header - Start of a trace file
+ * @magic: CT_TRACE_MAGIC
+ * @version: CT_TRACE_VERSION
+ * @sample_size: sizeof(struct ct_sample)
+ * @count: number of samples following the header
+ */
+struct ct_trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t sample_size;
+    uint64_t count;
+};
+
+/**
+ * struct ct_sample - Measurement of an operation
+ * @ticks: ticks of the operation, without those of the measurement
+ * @size: number of elements of the queue the operation ran on
+ * @mode: operation, DUT(x) of constant.h
+ * @class: 0 for the fixed class of inputs, 1 for the random one
+ * @reserved: zero
+ */
+struct ct_sample {
+    int64_t ticks;
+    uint32_t size;
+    uint8_t mode;
+    uint8_t class;
+    uint16_t reserved;
+};
+
+/**
+ * ct_trace_open() - Append the following measurements to a trace file
+ * @path: file, created if it does not exist
+ *
+ * Return: false if the file cannot be mapped or is not a trace
+ */
+bool ct_trace_open(const char *path);
+
+/* Stop appending the measurements, and trim the file to its samples */
+void ct_trace_close(void);
+
+/**
+ * ct_trace_append() - Append a batch of measurements of an operation
+ * @mode: operation
+ * @ticks: ticks of each measurement, those of zero or less are skipped
+ * @classes: class of the input of each measurement
+ * @sizes: size of the queue of each measurement
+ * @count: number of measurements
+ *
+ * Several threads may append at the same time.  Nothing is appended when no
+ * trace is open.
+ *
+ * Return: false if the file could not grow, which closes the trace
+ */
+bool ct_trace_append(int mode,
+                     const int64_t *ticks,
+                     const uint8_t *classes,
+                     const uint32_t *sizes,
+                     size_t count);
+
+#endif
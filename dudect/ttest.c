@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "ttest.h"
 
@@ -38,6 +39,24 @@ double t_compute(t_context_t *ctx)
     return t_value;
 }
 
+/* Combine the statistics of two sets of samples, as in Chan et al.,
+ * "Updating Formulae and a Pairwise Algorithm for Computing Sample
+ * Variances".
+ */
+void t_merge(t_context_t *ctx, const t_context_t *other)
+{
+    for (int class = 0; class < 2; class ++) {
+        double n = ctx->n[class] + other->n[class];
+        if (n == 0)
+            continue;
+        double delta = other->mean[class] - ctx->mean[class];
+        ctx->mean[class] += delta * other->n[class] / n;
+        ctx->m2[class] += other->m2[class] +
+                          delta * delta * ctx->n[class] * other->n[class] / n;
+        ctx->n[class] = n;
+    }
+}
+
 void t_init(t_context_t *ctx)
 {
     for (int class = 0; class < 2; class ++) {
@@ -47,3 +66,23 @@ void t_init(t_context_t *ctx)
     }
     return;
 }
+
+bool t_save(const t_context_t *ctx, size_t count, FILE *f)
+{
+    return fwrite(ctx, sizeof(*ctx), count, f) == count;
+}
+
+/* A context read back must be one t_push() and t_merge() can go on with */
+bool t_load(t_context_t *ctx, size_t count, FILE *f)
+{
+    if (fread(ctx, sizeof(*ctx), count, f) != count)
+        return false;
+    for (size_t i = 0; i < count; i++) {
+        for (int class = 0; class < 2; class ++) {
+            if (!(ctx[i].n[class] >= 0) || !(ctx[i].m2[class] >= 0) ||
+                !isfinite(ctx[i].mean[class]))
+                return false;
+        }
+    }
+    return true;
+}
@@ -1,7 +1,10 @@
 #ifndef DUDECT_TTEST_H
 #define DUDECT_TTEST_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 typedef struct {
     double mean[2];
@@ -11,6 +14,11 @@ typedef struct {
 
 void t_push(t_context_t *ctx, double x, uint8_t class);
 double t_compute(t_context_t *ctx);
+void t_merge(t_context_t *ctx, const t_context_t *other);
 void t_init(t_context_t *ctx);
 
+/* Write or read count contexts, as doubles in the byte order of the host */
+bool t_save(const t_context_t *ctx, size_t count, FILE *f);
+bool t_load(t_context_t *ctx, size_t count, FILE *f);
+
 #endif
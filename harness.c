@@ -1,12 +1,16 @@
 /* Test support code */
 
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include "random.h"
 #include "report.h"
 
 /* Our program needs to use regular malloc/free */
@@ -35,38 +39,128 @@
 typedef struct __block_element {
     struct __block_element *next, *prev;
     size_t payload_size;
+    size_t shard;        /* Index of the shard tracking this block */
     size_t magic_header; /* Marker to see if block seems legitimate */
     unsigned char payload[0];
     /* Also place magic number at tail of every block */
 } block_element_t;
 
-static block_element_t *allocated = NULL;
-static size_t allocated_count = 0;
+/* Live blocks are spread over several independently locked lists, so that
+ * threads allocating concurrently do not serialize on a single lock.  Each
+ * thread picks a home shard the first time it allocates and keeps putting
+ * its blocks there; a block remembers its shard, so it can be released from
+ * any thread.  Shards are cache-line aligned to avoid false sharing.
+ */
+#define N_SHARDS 16
+
+typedef struct {
+    pthread_mutex_t lock;
+    block_element_t *allocated;
+    size_t allocated_count;
+    size_t allocated_bytes; /* Payload bytes of the allocated blocks */
+    size_t peak_bytes;      /* Highest value of allocated_bytes */
+    size_t allocs;          /* Blocks ever allocated */
+} __attribute__((aligned(64))) shard_t;
+
+static shard_t shards[N_SHARDS] = {
+    [0 ... N_SHARDS - 1] = {.lock = PTHREAD_MUTEX_INITIALIZER},
+};
+
+static atomic_size_t next_shard = 0;
+static __thread size_t home_shard = N_SHARDS; /* N_SHARDS: not assigned yet */
+
+/* The time limit alarm longjmps away from the code it interrupts, which must
+ * not happen while a shard is locked or its list half updated.  The alarm is
+ * held off for the critical section instead: trigger_exception() only records
+ * the exception, raised once the section is over.  Blocking the signal with
+ * pthread_sigmask() would cost two system calls per allocation.
+ */
+static __thread volatile sig_atomic_t in_critical = false;
+static __thread char *volatile deferred_message = NULL;
+
+/* Per-thread state of the generator deciding on injected malloc failures */
+static __thread uintptr_t fail_seed = 0;
 
 /* Percent probability of malloc failure */
 int fail_probability = 0;
 
 static bool cautious_mode = true;
 static bool noallocate_mode = false;
-static bool error_occurred = false;
-static char *error_message = "";
+static atomic_bool error_occurred = false;
+static __thread char *error_message = "";
 
-static int time_limit = 1;
+/* Seconds a risky operation may run */
+int time_limit = 1;
 
-/* Data for managing exceptions */
-static jmp_buf env;
-static volatile sig_atomic_t jmp_ready = false;
-static bool time_limited = false;
+/* Data for managing exceptions, of the thread raising them */
+static __thread jmp_buf env;
+static __thread volatile sig_atomic_t jmp_ready = false;
+static __thread bool time_limited = false;
 
 /* Internal functions */
 
-/* Should this allocation fail? */
+/* Should this allocation fail?
+ * random() serializes on a global lock, hence every thread draws from its own
+ * generator, seeded from random() on first use.
+ */
 static bool fail_allocation()
 {
-    double weight = (double) random() / RAND_MAX;
+    if (fail_probability <= 0)
+        return false;
+
+    if (!fail_seed)
+        fail_seed = (uintptr_t) random() ^ (uintptr_t) &fail_seed;
+    /* splitmix: advance by the golden ratio, then scramble */
+    fail_seed += (uintptr_t) 0x9e3779b97f4a7c15ULL;
+    double weight = (double) (uint32_t) random_shuffle(fail_seed) / UINT32_MAX;
     return (weight < 0.01 * fail_probability);
 }
 
+static inline void shard_lock(shard_t *sh)
+{
+    in_critical = true;
+    atomic_signal_fence(memory_order_seq_cst);
+    pthread_mutex_lock(&sh->lock);
+}
+
+static inline void shard_unlock(shard_t *sh)
+{
+    pthread_mutex_unlock(&sh->lock);
+    atomic_signal_fence(memory_order_seq_cst);
+    in_critical = false;
+    if (deferred_message) {
+        char *msg = deferred_message;
+        deferred_message = NULL;
+        trigger_exception(msg);
+    }
+}
+
+/* Shard the calling thread records its allocations in */
+static shard_t *local_shard()
+{
+    if (home_shard == N_SHARDS)
+        home_shard = atomic_fetch_add(&next_shard, 1) % N_SHARDS;
+    return &shards[home_shard];
+}
+
+/* Is b a block currently recorded as allocated?
+ * The shard the header names is searched first.  The header may be bogus,
+ * so the other shards are searched as well when the block is not there.
+ */
+static bool is_allocated(block_element_t *b)
+{
+    size_t first = b->shard < N_SHARDS ? b->shard : 0;
+    bool found = false;
+    for (size_t i = 0; i < N_SHARDS && !found; i++) {
+        shard_t *sh = &shards[(first + i) % N_SHARDS];
+        shard_lock(sh);
+        for (block_element_t *ab = sh->allocated; ab && !found; ab = ab->next)
+            found = ab == b;
+        shard_unlock(sh);
+    }
+    return found;
+}
+
 /* Find header of block, given its payload.
  * Signal error if doesn't seem like legitimate block
  */
@@ -81,13 +175,7 @@ static block_element_t *find_header(void *p)
         (block_element_t *) ((size_t) p - sizeof(block_element_t));
     if (cautious_mode) {
         /* Make sure this is really an allocated block */
-        block_element_t *ab = allocated;
-        bool found = false;
-        while (ab && !found) {
-            found = ab == b;
-            ab = ab->next;
-        }
-        if (!found) {
+        if (!is_allocated(b)) {
             report_event(MSG_ERROR,
                          "Attempted to free unallocated block.  Address = %p",
                          p);
@@ -143,15 +231,24 @@ void *test_malloc(size_t size)
     *find_footer(new_block) = MAGICFOOTER;
     void *p = (void *) &new_block->payload;
     memset(p, FILLCHAR, size);
+
+    shard_t *sh = local_shard();
     // cppcheck-suppress nullPointerRedundantCheck
-    new_block->next = allocated;
+    new_block->shard = sh - shards;
     // cppcheck-suppress nullPointerRedundantCheck
     new_block->prev = NULL;
 
-    if (allocated)
-        allocated->prev = new_block;
-    allocated = new_block;
-    allocated_count++;
+    shard_lock(sh);
+    new_block->next = sh->allocated;
+    if (sh->allocated)
+        sh->allocated->prev = new_block;
+    sh->allocated = new_block;
+    sh->allocated_count++;
+    sh->allocated_bytes += size;
+    if (sh->allocated_bytes > sh->peak_bytes)
+        sh->peak_bytes = sh->allocated_bytes;
+    sh->allocs++;
+    shard_unlock(sh);
 
     return p;
 }
@@ -179,6 +276,15 @@ void test_free(void *p)
         return;
 
     block_element_t *b = find_header(p);
+    if (b->shard >= N_SHARDS) {
+        report_event(MSG_ERROR,
+                     "Corruption detected in header of block with address %p "
+                     "when attempting to free it",
+                     p);
+        error_occurred = true;
+        return;
+    }
+
     size_t footer = *find_footer(b);
     if (footer != MAGICFOOTER) {
         report_event(MSG_ERROR,
@@ -192,17 +298,21 @@ void test_free(void *p)
     memset(p, FILLCHAR, b->payload_size);
 
     /* Unlink from list */
+    shard_t *sh = &shards[b->shard];
+    shard_lock(sh);
     block_element_t *bn = b->next;
     block_element_t *bp = b->prev;
     if (bp)
         bp->next = bn;
     else
-        allocated = bn;
+        sh->allocated = bn;
     if (bn)
         bn->prev = bp;
+    sh->allocated_count--;
+    sh->allocated_bytes -= b->payload_size;
+    shard_unlock(sh);
 
     free(b);
-    allocated_count--;
 }
 
 // cppcheck-suppress unusedFunction
@@ -216,9 +326,44 @@ char *test_strdup(const char *s)
     return memcpy(new, s, len);
 }
 
+/* Count the blocks still allocated, checking that each of them is intact */
 size_t allocation_check()
 {
-    return allocated_count;
+    size_t count = 0;
+    for (size_t i = 0; i < N_SHARDS; i++) {
+        shard_t *sh = &shards[i];
+        shard_lock(sh);
+        for (block_element_t *b = sh->allocated; b; b = b->next) {
+            if (b->magic_header != MAGICHEADER ||
+                *find_footer(b) != MAGICFOOTER) {
+                report_event(MSG_ERROR,
+                             "Corruption detected in allocated block with "
+                             "address %p",
+                             (void *) &b->payload);
+                error_occurred = true;
+            }
+        }
+        count += sh->allocated_count;
+        shard_unlock(sh);
+    }
+    return count;
+}
+
+/* The peak is the sum of the peaks of the shards, which is exact when blocks
+ * are only allocated by a single thread, and an upper bound otherwise.
+ */
+void mem_stats(mem_stats_t *ms)
+{
+    memset(ms, 0, sizeof(*ms));
+    for (size_t i = 0; i < N_SHARDS; i++) {
+        shard_t *sh = &shards[i];
+        shard_lock(sh);
+        ms->blocks += sh->allocated_count;
+        ms->bytes += sh->allocated_bytes;
+        ms->peak_bytes += sh->peak_bytes;
+        ms->allocs += sh->allocs;
+        shard_unlock(sh);
+    }
 }
 
 /* Implementation of functions for testing */
@@ -242,9 +387,7 @@ void set_noallocate_mode(bool noallocate)
 /* Return whether any errors have occurred since last time set error limit */
 bool error_check()
 {
-    bool e = error_occurred;
-    error_occurred = false;
-    return e;
+    return atomic_exchange(&error_occurred, false);
 }
 
 /* Prepare for a risky operation using setjmp.
@@ -255,6 +398,7 @@ bool exception_setup(bool limit_time)
     if (sigsetjmp(env, 1)) {
         /* Got here from longjmp */
         jmp_ready = false;
+        deferred_message = NULL;
         if (time_limited) {
             alarm(0);
             time_limited = false;
@@ -290,6 +434,10 @@ void exception_cancel()
 /* Use longjmp to return to most recent exception setup */
 void trigger_exception(char *msg)
 {
+    if (in_critical) {
+        deferred_message = msg;
+        return;
+    }
     error_occurred = true;
     error_message = msg;
     if (jmp_ready)
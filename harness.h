@@ -8,6 +8,11 @@
 /* This test harness enables us to do stringent testing of code.
  * It overloads the library versions of malloc and free with ones that
  * allow checking for common allocation errors.
+ *
+ * The allocation functions may be called concurrently from several threads.
+ * Each thread has its own exception context (exception_setup and friends), but
+ * the time limit is only meant for the thread running the command
+ * interpreter; other threads should block SIGALRM.
  */
 
 void *test_malloc(size_t size);
@@ -18,12 +23,26 @@ char *test_strdup(const char *s);
 
 #ifdef INTERNAL
 
-/* Report number of allocated blocks */
+/* Report number of allocated blocks, flagging any that has been corrupted */
 size_t allocation_check();
 
+/* Memory allocated through the harness */
+typedef struct {
+    size_t blocks;     /* Blocks currently allocated */
+    size_t bytes;      /* Payload bytes of these blocks */
+    size_t peak_bytes; /* Highest number of payload bytes allocated */
+    size_t allocs;     /* Number of blocks allocated since the start */
+} mem_stats_t;
+
+/* Gather the memory statistics, without checking the blocks */
+void mem_stats(mem_stats_t *ms);
+
 /* Probability of malloc failing, expressed as percent */
 extern int fail_probability;
 
+/* Time limit of operations started by exception_setup(true), in seconds */
+extern int time_limit;
+
 /*
  * Set/unset cautious mode.
  * In this mode, makes extra sure any block to be freed is currently allocated.
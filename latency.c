@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "latency.h"
+
+#define LAT_HALF_BITS (LAT_SUB_BITS - 1)
+
+/* Values of [2^k, 2^(k+1)), for k >= LAT_SUB_BITS, are cut into buckets of
+ * 2^(k - LAT_HALF_BITS) values.  Shifted right by that amount, a value lands
+ * in the upper half of the sub-buckets, so the buckets of successive powers
+ * of two follow each other.
+ */
+static int bucket_of(uint64_t v)
+{
+    if (v >> LAT_MAX_BITS)
+        v = ((uint64_t) 1 << LAT_MAX_BITS) - 1;
+    if (v < LAT_SUB_BUCKETS)
+        return (int) v;
+    int shift = 63 - __builtin_clzll(v) - LAT_HALF_BITS;
+    return (shift << LAT_HALF_BITS) + (int) (v >> shift);
+}
+
+/* Highest value falling in bucket i */
+static uint64_t bucket_high(int i)
+{
+    if (i < LAT_SUB_BUCKETS)
+        return i;
+    int shift = (i >> LAT_HALF_BITS) - 1;
+    uint64_t m = i - (shift << LAT_HALF_BITS);
+    return ((m + 1) << shift) - 1;
+}
+
+void lat_reset(struct latency *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void lat_record(struct latency *h, uint64_t ns)
+{
+    h->bucket[bucket_of(ns)]++;
+    h->count++;
+    if (ns > h->max)
+        h->max = ns;
+}
+
+uint64_t lat_percentile(const struct latency *h, double p)
+{
+    if (!h->count)
+        return 0;
+
+    /* Rank of the percentile among the recorded values, from 1 */
+    uint64_t rank = (uint64_t) (p / 100 * h->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > h->count)
+        rank = h->count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= rank) {
+            uint64_t high = bucket_high(i);
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
@@ -0,0 +1,57 @@
+#ifndef LAB0_LATENCY_H
+#define LAB0_LATENCY_H
+
+/* Latency histogram in the manner of HdrHistogram.
+ *
+ * Values are counted in log-linear buckets: every power of two is split into
+ * LAT_SUB_BUCKETS / 2 buckets of equal width, so that any recorded value is
+ * known to within 1/32 of itself (about 3%), from one nanosecond up to days,
+ * in a fixed amount of memory.  Recording a value takes constant time.
+ */
+
+#include <stdint.h>
+
+/* Values below LAT_SUB_BUCKETS have a bucket each */
+#define LAT_SUB_BITS 6
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+
+/* Values are clamped below 2^LAT_MAX_BITS ns, which is more than 39 hours */
+#define LAT_MAX_BITS 47
+#define LAT_BUCKETS \
+    ((LAT_MAX_BITS - LAT_SUB_BITS + 2) * (LAT_SUB_BUCKETS / 2))
+
+/**
+ * struct latency - Histogram of latencies
+ * @count: number of recorded values
+ * @max: largest recorded value
+ * @bucket: number of recorded values falling in each bucket
+ */
+struct latency {
+    uint64_t count, max;
+    uint64_t bucket[LAT_BUCKETS];
+};
+
+/**
+ * lat_reset() - Empty a histogram
+ * @h: histogram
+ */
+void lat_reset(struct latency *h);
+
+/**
+ * lat_record() - Record a value
+ * @h: histogram
+ * @ns: latency in nanoseconds
+ */
+void lat_record(struct latency *h, uint64_t ns);
+
+/**
+ * lat_percentile() - Estimate a percentile of the recorded values
+ * @h: histogram
+ * @p: percentile, between 0 and 100
+ *
+ * Return: the highest value of the bucket holding the percentile, bounded by
+ * the largest recorded value, or 0 if nothing was recorded
+ */
+uint64_t lat_percentile(const struct latency *h, double p);
+
+#endif /* LAB0_LATENCY_H */
@@ -1,8 +1,9 @@
 /*
- * Generate precalculated values of log2 with assumption that arg will be left
- * shifted by 16 bit and return value of log2_lshift16() will be left shifted
- * by 3 bit All that shifts used for avoid of using floating point in
- * calculation.
+ * Precalculated values of log2, with the assumption that the argument is left
+ * shifted by 16 bits and that the return value of log2_lshift16() is left
+ * shifted by 3 bits.  All the shifts avoid floating point in the calculation.
+ *
+ * Generated by scripts/gen-log2.py, do not edit.
  */
 
 #include <stdint.h>
@@ -10,273 +11,123 @@
 #define LOG2_ARG_SHIFT (1 << 16)
 #define LOG2_RET_SHIFT (1 << 3)
 
-/* store precalculated function (log2(arg << 24)) << 3 */
+/* Result at the start of each range of arguments, and the last argument of
+ * that result, past which it is one more.  The ranges are indexed by the
+ * leading bit of 2x + 1 and the 5 bits following it.
+ */
+static const int16_t log2_lshift16_base[544] = {
+    -136,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    -123,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    -117,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0, -113,    0,    0,    0,    0,    0,    0,    0,
+       0,    0,    0,    0, -110,    0,    0,    0,    0,    0,    0,    0,
+    -108,    0,    0,    0,    0,    0,    0,    0, -106,    0,    0,    0,
+       0,    0,    0,    0, -104,    0,    0,    0,    0,    0, -103,    0,
+       0,    0, -102,    0,    0,    0, -100,    0,    0,    0,  -99,    0,
+       0,    0,  -98,    0,    0,    0,  -97,    0,    0,    0,  -97,    0,
+       0,    0,  -96,    0,    0,  -95,    0,  -94,    0,  -94,    0,  -93,
+       0,  -93,    0,  -92,    0,  -92,    0,  -91,    0,  -91,    0,  -90,
+       0,  -90,    0,  -89,    0,  -89,    0,  -88,    0,  -88,    0,  -88,
+     -87,  -87,  -87,  -86,  -86,  -86,  -85,  -85,  -85,  -84,  -84,  -84,
+     -84,  -83,  -83,  -83,  -83,  -82,  -82,  -82,  -82,  -82,  -81,  -81,
+     -81,  -81,  -81,  -80,  -80,  -80,  -80,  -80,  -79,  -79,  -79,  -78,
+     -78,  -78,  -77,  -77,  -77,  -77,  -76,  -76,  -76,  -76,  -75,  -75,
+     -75,  -75,  -74,  -74,  -74,  -74,  -73,  -73,  -73,  -73,  -73,  -72,
+     -72,  -72,  -72,  -72,  -71,  -71,  -71,  -70,  -70,  -70,  -69,  -69,
+     -69,  -69,  -68,  -68,  -68,  -68,  -67,  -67,  -67,  -67,  -66,  -66,
+     -66,  -66,  -65,  -65,  -65,  -65,  -65,  -64,  -64,  -64,  -64,  -64,
+     -63,  -63,  -63,  -62,  -62,  -62,  -61,  -61,  -61,  -61,  -60,  -60,
+     -60,  -60,  -59,  -59,  -59,  -59,  -58,  -58,  -58,  -58,  -57,  -57,
+     -57,  -57,  -57,  -56,  -56,  -56,  -56,  -56,  -55,  -55,  -55,  -54,
+     -54,  -54,  -54,  -53,  -53,  -53,  -52,  -52,  -52,  -52,  -51,  -51,
+     -51,  -51,  -50,  -50,  -50,  -50,  -49,  -49,  -49,  -49,  -49,  -48,
+     -48,  -48,  -48,  -48,  -47,  -47,  -47,  -46,  -46,  -46,  -46,  -45,
+     -45,  -45,  -44,  -44,  -44,  -44,  -43,  -43,  -43,  -43,  -42,  -42,
+     -42,  -42,  -41,  -41,  -41,  -41,  -41,  -40,  -40,  -40,  -40,  -40,
+     -39,  -39,  -39,  -38,  -38,  -38,  -38,  -37,  -37,  -37,  -36,  -36,
+     -36,  -36,  -35,  -35,  -35,  -35,  -34,  -34,  -34,  -34,  -33,  -33,
+     -33,  -33,  -33,  -32,  -32,  -32,  -32,  -32,  -31,  -31,  -31,  -30,
+     -30,  -30,  -30,  -29,  -29,  -29,  -28,  -28,  -28,  -28,  -27,  -27,
+     -27,  -27,  -26,  -26,  -26,  -26,  -25,  -25,  -25,  -25,  -25,  -24,
+     -24,  -24,  -24,  -24,  -23,  -23,  -23,  -22,  -22,  -22,  -22,  -21,
+     -21,  -21,  -20,  -20,  -20,  -20,  -19,  -19,  -19,  -19,  -18,  -18,
+     -18,  -18,  -17,  -17,  -17,  -17,  -17,  -16,  -16,  -16,  -16,  -16,
+     -15,  -15,  -15,  -14,  -14,  -14,  -14,  -13,  -13,  -13,  -12,  -12,
+     -12,  -12,  -11,  -11,  -11,  -11,  -10,  -10,  -10,  -10,   -9,   -9,
+      -9,   -9,   -9,   -8,   -8,   -8,   -8,   -8,   -7,   -7,   -7,   -6,
+      -6,   -6,   -6,   -5,   -5,   -5,   -4,   -4,   -4,   -4,   -3,   -3,
+      -3,   -3,   -2,   -2,   -2,   -2,   -1,   -1,   -1,   -1,   -1,    0,
+       0,    0,    0,    0,
+};
+
+static const uint16_t log2_lshift16_last[544] = {
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535,    82, 65535, 65535, 65535,    90, 65535, 65535,
+    65535,    98, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+      116, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 65535,   165, 65535, 65535, 65535,   180,
+    65535, 65535, 65535,   196, 65535, 65535, 65535,   214, 65535, 65535,
+    65535, 65535,   234, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+      278, 65535, 65535, 65535, 65535, 65535, 65535,   331, 65535, 65535,
+    65535,   361, 65535, 65535, 65535,   394, 65535, 65535, 65535,   430,
+    65535, 65535, 65535, 65535,   469, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535,   557, 65535, 65535, 65535,   608, 65535, 65535,   663,
+    65535, 65535, 65535,   723, 65535, 65535, 65535,   789, 65535, 65535,
+    65535,   860, 65535, 65535, 65535, 65535,   938, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535,  1116, 65535, 65535, 65535,  1217, 65535,
+    65535,  1327, 65535, 65535, 65535,  1447, 65535, 65535, 65535,  1578,
+    65535, 65535, 65535,  1721, 65535, 65535, 65535, 65535,  1877, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535,  2232, 65535, 65535, 65535,
+     2434, 65535, 65535,  2655, 65535, 65535, 65535,  2895, 65535, 65535,
+    65535,  3157, 65535, 65535, 65535,  3443, 65535, 65535, 65535, 65535,
+     3755, 65535, 65535, 65535, 65535, 65535, 65535, 65535,  4466, 65535,
+    65535, 65535,  4870, 65535, 65535,  5311, 65535, 65535, 65535,  5792,
+    65535, 65535, 65535,  6316, 65535, 65535, 65535,  6888, 65535, 65535,
+    65535, 65535,  7511, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+     8932, 65535, 65535, 65535,  9741, 65535, 65535, 10623, 65535, 65535,
+    65535, 11584, 65535, 65535, 65535, 12633, 65535, 65535, 65535, 13776,
+    65535, 65535, 65535, 65535, 15023, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 17866, 65535, 65535, 65535, 19483, 65535, 65535, 21246,
+    65535, 65535, 65535, 23169, 65535, 65535, 65535, 25267, 65535, 65535,
+    65535, 27553, 65535, 65535, 65535, 65535, 30047, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 35733, 65535, 65535, 65535, 38967, 65535,
+    65535, 42494, 65535, 65535, 65535, 46340, 65535, 65535, 65535, 50534,
+    65535, 65535, 65535, 55108, 65535, 65535, 65535, 65535, 60096, 65535,
+    65535, 65535, 65535, 65535,
+};
+
+/* (log2(lshift16 / 2^16)) << 3, without a branch */
 static inline int log2_lshift16(uint64_t lshift16)
 {
-    if (lshift16 < 558) {
-        if (lshift16 < 54) {
-            if (lshift16 < 13) {
-                if (lshift16 < 7) {
-                    if (lshift16 < 1)
-                        return -136;
-                    if (lshift16 < 2)
-                        return -123;
-                    if (lshift16 < 3)
-                        return -117;
-                    if (lshift16 < 4)
-                        return -113;
-                    if (lshift16 < 5)
-                        return -110;
-                    if (lshift16 < 6)
-                        return -108;
-                    if (lshift16 < 7)
-                        return -106;
-                } else {
-                    if (lshift16 < 8)
-                        return -104;
-                    if (lshift16 < 9)
-                        return -103;
-                    if (lshift16 < 10)
-                        return -102;
-                    if (lshift16 < 11)
-                        return -100;
-                    if (lshift16 < 12)
-                        return -99;
-                    if (lshift16 < 13)
-                        return -98;
-                }
-            } else {
-                if (lshift16 < 29) {
-                    if (lshift16 < 15)
-                        return -97;
-                    if (lshift16 < 16)
-                        return -96;
-                    if (lshift16 < 17)
-                        return -95;
-                    if (lshift16 < 19)
-                        return -94;
-                    if (lshift16 < 21)
-                        return -93;
-                    if (lshift16 < 23)
-                        return -92;
-                    if (lshift16 < 25)
-                        return -91;
-                    if (lshift16 < 27)
-                        return -90;
-                    if (lshift16 < 29)
-                        return -89;
-                } else {
-                    if (lshift16 < 32)
-                        return -88;
-                    if (lshift16 < 35)
-                        return -87;
-                    if (lshift16 < 38)
-                        return -86;
-                    if (lshift16 < 41)
-                        return -85;
-                    if (lshift16 < 45)
-                        return -84;
-                    if (lshift16 < 49)
-                        return -83;
-                    if (lshift16 < 54)
-                        return -82;
-                }
-            }
-        } else {
-            if (lshift16 < 181) {
-                if (lshift16 < 99) {
-                    if (lshift16 < 59)
-                        return -81;
-                    if (lshift16 < 64)
-                        return -80;
-                    if (lshift16 < 70)
-                        return -79;
-                    if (lshift16 < 76)
-                        return -78;
-                    if (lshift16 < 83)
-                        return -77;
-                    if (lshift16 < 91)
-                        return -76;
-                    if (lshift16 < 99)
-                        return -75;
-                } else {
-                    if (lshift16 < 108)
-                        return -74;
-                    if (lshift16 < 117)
-                        return -73;
-                    if (lshift16 < 128)
-                        return -72;
-                    if (lshift16 < 140)
-                        return -71;
-                    if (lshift16 < 152)
-                        return -70;
-                    if (lshift16 < 166)
-                        return -69;
-                    if (lshift16 < 181)
-                        return -68;
-                }
-            } else {
-                if (lshift16 < 304) {
-                    if (lshift16 < 197)
-                        return -67;
-                    if (lshift16 < 215)
-                        return -66;
-                    if (lshift16 < 235)
-                        return -65;
-                    if (lshift16 < 256)
-                        return -64;
-                    if (lshift16 < 279)
-                        return -63;
-                    if (lshift16 < 304)
-                        return -62;
-                } else {
-                    if (lshift16 < 332)
-                        return -61;
-                    if (lshift16 < 362)
-                        return -60;
-                    if (lshift16 < 395)
-                        return -59;
-                    if (lshift16 < 431)
-                        return -58;
-                    if (lshift16 < 470)
-                        return -57;
-                    if (lshift16 < 512)
-                        return -56;
-                    if (lshift16 < 558)
-                        return -55;
-                }
-            }
-        }
-    } else {
-        if (lshift16 < 6317) {
-            if (lshift16 < 2048) {
-                if (lshift16 < 1117) {
-                    if (lshift16 < 609)
-                        return -54;
-                    if (lshift16 < 664)
-                        return -53;
-                    if (lshift16 < 724)
-                        return -52;
-                    if (lshift16 < 790)
-                        return -51;
-                    if (lshift16 < 861)
-                        return -50;
-                    if (lshift16 < 939)
-                        return -49;
-                    if (lshift16 < 1024)
-                        return -48;
-                    if (lshift16 < 1117)
-                        return -47;
-                } else {
-                    if (lshift16 < 1218)
-                        return -46;
-                    if (lshift16 < 1328)
-                        return -45;
-                    if (lshift16 < 1448)
-                        return -44;
-                    if (lshift16 < 1579)
-                        return -43;
-                    if (lshift16 < 1722)
-                        return -42;
-                    if (lshift16 < 1878)
-                        return -41;
-                    if (lshift16 < 2048)
-                        return -40;
-                }
-            } else {
-                if (lshift16 < 3756) {
-                    if (lshift16 < 2233)
-                        return -39;
-                    if (lshift16 < 2435)
-                        return -38;
-                    if (lshift16 < 2656)
-                        return -37;
-                    if (lshift16 < 2896)
-                        return -36;
-                    if (lshift16 < 3158)
-                        return -35;
-                    if (lshift16 < 3444)
-                        return -34;
-                    if (lshift16 < 3756)
-                        return -33;
-                } else {
-                    if (lshift16 < 4096)
-                        return -32;
-                    if (lshift16 < 4467)
-                        return -31;
-                    if (lshift16 < 4871)
-                        return -30;
-                    if (lshift16 < 5312)
-                        return -29;
-                    if (lshift16 < 5793)
-                        return -28;
-                    if (lshift16 < 6317)
-                        return -27;
-                }
-            }
-        } else {
-            if (lshift16 < 21247) {
-                if (lshift16 < 11585) {
-                    if (lshift16 < 6889)
-                        return -26;
-                    if (lshift16 < 7512)
-                        return -25;
-                    if (lshift16 < 8192)
-                        return -24;
-                    if (lshift16 < 8933)
-                        return -23;
-                    if (lshift16 < 9742)
-                        return -22;
-                    if (lshift16 < 10624)
-                        return -21;
-                    if (lshift16 < 11585)
-                        return -20;
-                } else {
-                    if (lshift16 < 12634)
-                        return -19;
-                    if (lshift16 < 13777)
-                        return -18;
-                    if (lshift16 < 15024)
-                        return -17;
-                    if (lshift16 < 16384)
-                        return -16;
-                    if (lshift16 < 17867)
-                        return -15;
-                    if (lshift16 < 19484)
-                        return -14;
-                    if (lshift16 < 21247)
-                        return -13;
-                }
-            } else {
-                if (lshift16 < 35734) {
-                    if (lshift16 < 23170)
-                        return -12;
-                    if (lshift16 < 25268)
-                        return -11;
-                    if (lshift16 < 27554)
-                        return -10;
-                    if (lshift16 < 30048)
-                        return -9;
-                    if (lshift16 < 32768)
-                        return -8;
-                    if (lshift16 < 35734)
-                        return -7;
-                } else {
-                    if (lshift16 < 38968)
-                        return -6;
-                    if (lshift16 < 42495)
-                        return -5;
-                    if (lshift16 < 46341)
-                        return -4;
-                    if (lshift16 < 50535)
-                        return -3;
-                    if (lshift16 < 55109)
-                        return -2;
-                    if (lshift16 < 60097)
-                        return -1;
-                }
-            }
-        }
-    }
-    return 0;
+    uint32_t x = lshift16 < 65535 ? lshift16 : 65535;
+    uint32_t v = 2 * x + 1;
+    int e = 31 - __builtin_clz(v);
+    uint32_t i = (uint32_t) e << 5 | ((v << (16 - e)) >> 11 & 31);
+    return log2_lshift16_base[i] + (x > log2_lshift16_last[i]);
 }
@@ -0,0 +1,53 @@
+#include <ctype.h>
+
+#include "order.h"
+
+int order_length_cmp(const char *a, const char *b)
+{
+    size_t la = strlen(a), lb = strlen(b);
+    if (la != lb)
+        return la < lb ? -1 : 1;
+    return strcmp(a, b);
+}
+
+int order_natural_cmp(const char *a, const char *b)
+{
+    const unsigned char *p = (const unsigned char *) a;
+    const unsigned char *q = (const unsigned char *) b;
+    while (*p && *q) {
+        if (!isdigit(*p) || !isdigit(*q)) {
+            if (*p != *q)
+                return *p < *q ? -1 : 1;
+            p++;
+            q++;
+            continue;
+        }
+
+        /* Without leading zeros, the longer run of digits is the greater
+         * number, and runs of the same length compare digit by digit.
+         */
+        while (*p == '0')
+            p++;
+        while (*q == '0')
+            q++;
+        size_t lp = 0, lq = 0;
+        while (isdigit(p[lp]))
+            lp++;
+        while (isdigit(q[lq]))
+            lq++;
+        if (lp != lq)
+            return lp < lq ? -1 : 1;
+        int c = memcmp(p, q, lp);
+        if (c)
+            return c;
+        p += lp;
+        q += lq;
+    }
+    if (*p != *q)
+        return *p < *q ? -1 : 1;
+
+    /* Strings differing only by leading zeros, e.g. "a01" and "a1", are not
+     * equal: strcmp() orders them, so that the order is total.
+     */
+    return strcmp(a, b);
+}
@@ -0,0 +1,83 @@
+#ifndef LAB0_ORDER_H
+#define LAB0_ORDER_H
+
+/* Orders to sort and merge queues in.
+ *
+ * q_sort() and q_merge() sort in ascending strcmp() order.  The variants
+ * declared here take the order as an extra argument, NULL standing for that
+ * default, so that a single merge kernel serves every order.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "queue.h"
+
+/**
+ * enum order_mode - How two strings compare
+ * @ORDER_LEX: byte by byte, as strcmp()
+ * @ORDER_LENGTH: shorter strings first, strings of equal length as strcmp()
+ * @ORDER_NATURAL: as strcmp(), except that runs of digits compare by their
+ *                 numeric value, so that "a9" sorts before "a10"; strings
+ *                 equal but for leading zeros compare as strcmp()
+ * @ORDER_MODES: number of modes
+ */
+enum order_mode {
+    ORDER_LEX,
+    ORDER_LENGTH,
+    ORDER_NATURAL,
+    ORDER_MODES,
+};
+
+/**
+ * struct order - Sorting order
+ * @mode: how two strings compare
+ * @descend: whether the order is reversed.  Equal strings keep their relative
+ *           order either way.
+ */
+struct order {
+    enum order_mode mode;
+    bool descend;
+};
+
+int order_length_cmp(const char *a, const char *b);
+int order_natural_cmp(const char *a, const char *b);
+
+/**
+ * order_cmp() - Compare two strings
+ * @o: order, NULL for ascending strcmp() order
+ * @a: first string
+ * @b: second string
+ *
+ * Return: negative if @a sorts before @b, positive if after, zero if equal
+ */
+static inline int order_cmp(const struct order *o, const char *a, const char *b)
+{
+    if (!o)
+        return strcmp(a, b);
+    int c = o->mode == ORDER_LENGTH    ? order_length_cmp(a, b)
+            : o->mode == ORDER_NATURAL ? order_natural_cmp(a, b)
+                                       : strcmp(a, b);
+    return o->descend ? -c : c;
+}
+
+/**
+ * q_sort_by() - Sort elements of queue in a given order
+ * @head: header of queue
+ * @o: order, NULL for the ascending order of q_sort()
+ *
+ * The sort is stable.
+ */
+void q_sort_by(struct list_head *head, const struct order *o);
+
+/**
+ * q_merge_by() - Merge all the queues into one queue sorted in a given order
+ * @head: header of chain
+ * @o: order the queues are sorted in, NULL for the ascending order of
+ *     q_merge()
+ *
+ * Return: the number of elements in queue after merging
+ */
+int q_merge_by(struct list_head *head, const struct order *o);
+
+#endif /* LAB0_ORDER_H */
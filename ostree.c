@@ -0,0 +1,293 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ostree.h"
+#include "random.h"
+
+static inline size_t node_size(const struct ost_node *node)
+{
+    return node ? node->size : 0;
+}
+
+static inline void update(struct ost_node *node)
+{
+    node->size = node_size(node->left) + node_size(node->right) + 1;
+}
+
+/* Does the value of node sort before s, or is equal to it if inclusive? */
+static inline bool goes_left(const struct ost_node *node,
+                             const char *s,
+                             bool inclusive)
+{
+    int c = strcmp(node->elem->value, s);
+    return c < 0 || (inclusive && c == 0);
+}
+
+/* Split tree t into l, holding the values sorting before s (and equal to s if
+ * inclusive), and r, holding all the others.
+ */
+static void split(struct ost_node *t,
+                  const char *s,
+                  bool inclusive,
+                  struct ost_node **l,
+                  struct ost_node **r)
+{
+    if (!t) {
+        *l = *r = NULL;
+        return;
+    }
+    if (goes_left(t, s, inclusive)) {
+        split(t->right, s, inclusive, &t->right, r);
+        *l = t;
+    } else {
+        split(t->left, s, inclusive, l, &t->left);
+        *r = t;
+    }
+    update(t);
+}
+
+/* Join two trees, every value of l sorting before or equal to those of r */
+static struct ost_node *merge(struct ost_node *l, struct ost_node *r)
+{
+    if (!l || !r)
+        return l ? l : r;
+    if (l->prio > r->prio) {
+        l->right = merge(l->right, r);
+        update(l);
+        return l;
+    }
+    r->left = merge(l, r->left);
+    update(r);
+    return r;
+}
+
+/* Free a node unless it belongs to the array allocated when building the
+ * tree
+ */
+static void release_node(struct ostree *t, struct ost_node *node)
+{
+    if (node < t->nodes || node >= t->nodes + t->n_nodes)
+        free(node);
+}
+
+/* Unlink and free the elements of a subtree, and the nodes inserted since the
+ * tree was built.
+ */
+static void release_elements(struct ostree *t, struct ost_node *node)
+{
+    if (!node)
+        return;
+    release_elements(t, node->left);
+    release_elements(t, node->right);
+    list_del(&node->elem->list);
+    q_release_element(node->elem);
+    release_node(t, node);
+}
+
+/* Free the nodes of a subtree inserted since the tree was built */
+static void release_nodes(struct ostree *t, struct ost_node *node)
+{
+    if (!node)
+        return;
+    release_nodes(t, node->left);
+    release_nodes(t, node->right);
+    release_node(t, node);
+}
+
+/* Sort record of a node: comparing the leading bytes of the values packed
+ * into an integer settles most comparisons without touching the strings.
+ */
+struct sort_rec {
+    uint64_t prefix;
+    struct ost_node *node;
+};
+
+static uint64_t value_prefix(const char *s)
+{
+    uint64_t prefix = 0;
+    int i = 0;
+    for (; i < 8 && s[i]; i++)
+        prefix = (prefix << 8) | (unsigned char) s[i];
+    return prefix << (8 * (8 - i));
+}
+
+static int cmp_rec(const void *a, const void *b)
+{
+    const struct sort_rec *ra = a, *rb = b;
+    if (ra->prefix != rb->prefix)
+        return ra->prefix < rb->prefix ? -1 : 1;
+    return strcmp(ra->node->elem->value, rb->node->elem->value);
+}
+
+static void fix_sizes(struct ost_node *node)
+{
+    if (!node)
+        return;
+    fix_sizes(node->left);
+    fix_sizes(node->right);
+    update(node);
+}
+
+struct ostree *ost_new(struct list_head *head)
+{
+    if (!head)
+        return NULL;
+    struct ostree *t = malloc(sizeof(struct ostree));
+    if (!t)
+        return NULL;
+    t->head = head;
+    t->root = NULL;
+    t->nodes = NULL;
+    t->n_nodes = 0;
+    t->seed = (uintptr_t) t;
+
+    size_t n = 0;
+    struct list_head *node;
+    list_for_each (node, head)
+        n++;
+    if (!n)
+        return t;
+
+    /* Inserting the elements one at a time chases pointers all over the
+     * tree, so sort them first and build the treap in a single pass.
+     */
+    t->nodes = malloc(n * sizeof(struct ost_node));
+    struct sort_rec *recs = malloc(n * sizeof(struct sort_rec));
+    if (!t->nodes || !recs) {
+        free(recs);
+        ost_free(t);
+        return NULL;
+    }
+    t->n_nodes = n;
+    size_t i = 0;
+    element_t *e;
+    list_for_each_entry (e, head, list) {
+        struct ost_node *x = &t->nodes[i];
+        t->seed += (uintptr_t) 0x9e3779b97f4a7c15ULL;
+        x->elem = e;
+        x->prio = (uint32_t) random_shuffle(t->seed);
+        x->left = x->right = NULL;
+        recs[i].prefix = value_prefix(e->value);
+        recs[i++].node = x;
+    }
+    qsort(recs, n, sizeof(struct sort_rec), cmp_rec);
+
+    /* Build the Cartesian tree of the priorities over the sorted nodes. The
+     * right spine is kept as a stack, reusing the array of records.
+     */
+    size_t depth = 0;
+    for (i = 0; i < n; i++) {
+        struct ost_node *x = recs[i].node, *last = NULL;
+        while (depth && recs[depth - 1].node->prio < x->prio)
+            last = recs[--depth].node;
+        x->left = last;
+        if (depth)
+            recs[depth - 1].node->right = x;
+        recs[depth++].node = x;
+    }
+    t->root = recs[0].node;
+    free(recs);
+    fix_sizes(t->root);
+    return t;
+}
+
+void ost_free(struct ostree *t)
+{
+    if (!t)
+        return;
+    release_nodes(t, t->root);
+    free(t->nodes);
+    free(t);
+}
+
+size_t ost_size(const struct ostree *t)
+{
+    return node_size(t->root);
+}
+
+/* Count the values sorting before s, and equal to s as well if inclusive */
+static size_t count_below(const struct ostree *t, const char *s, bool inclusive)
+{
+    size_t n = 0;
+    const struct ost_node *node = t->root;
+    while (node) {
+        if (goes_left(node, s, inclusive)) {
+            n += node_size(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return n;
+}
+
+size_t ost_rank(const struct ostree *t, const char *s)
+{
+    return count_below(t, s, false);
+}
+
+size_t ost_count(const struct ostree *t, const char *lo, const char *hi)
+{
+    if (strcmp(lo, hi) > 0)
+        return 0;
+    return count_below(t, hi, true) - count_below(t, lo, false);
+}
+
+bool ost_insert(struct ostree *t, element_t *e)
+{
+    struct ost_node *x = malloc(sizeof(struct ost_node));
+    if (!x)
+        return false;
+    t->seed += (uintptr_t) 0x9e3779b97f4a7c15ULL;
+    x->elem = e;
+    x->prio = (uint32_t) random_shuffle(t->seed);
+    x->left = x->right = NULL;
+    x->size = 1;
+
+    struct ost_node *l, *r;
+    split(t->root, e->value, true, &l, &r);
+    t->root = merge(merge(l, x), r);
+    return true;
+}
+
+/* Unlink the node of element e from the subtree at *link.  Values equal to
+ * the one of a node may sit on either side of it, so both are searched.
+ */
+static bool remove_elem(struct ostree *t,
+                        struct ost_node **link,
+                        const element_t *e)
+{
+    struct ost_node *node = *link;
+    if (!node)
+        return false;
+    if (node->elem == e) {
+        *link = merge(node->left, node->right);
+        release_node(t, node);
+        return true;
+    }
+    int c = strcmp(e->value, node->elem->value);
+    bool found = (c <= 0 && remove_elem(t, &node->left, e)) ||
+                 (c >= 0 && remove_elem(t, &node->right, e));
+    if (found)
+        update(node);
+    return found;
+}
+
+bool ost_remove(struct ostree *t, const element_t *e)
+{
+    return remove_elem(t, &t->root, e);
+}
+
+size_t ost_delete_range(struct ostree *t, const char *lo, const char *hi)
+{
+    if (strcmp(lo, hi) > 0)
+        return 0;
+    struct ost_node *l, *m, *r;
+    split(t->root, lo, false, &l, &m);
+    split(m, hi, true, &m, &r);
+    size_t n = node_size(m);
+    release_elements(t, m);
+    t->root = merge(l, r);
+    return n;
+}
@@ -0,0 +1,128 @@
+#ifndef LAB0_OSTREE_H
+#define LAB0_OSTREE_H
+
+/* Order-statistic tree indexing the elements of a queue by value.
+ *
+ * The tree is a treap: a binary search tree on the element strings which is
+ * kept balanced in expectation by heap-ordering random node priorities.
+ * Every node also counts the nodes of its subtree, which answers rank and
+ * range counting queries in O(log n) time.  As with the skip list index, the
+ * elements stay linked in the queue; the tree must be rebuilt after the queue
+ * is modified behind its back, unless the change is passed on by
+ * ost_insert() or ost_remove().
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "queue.h"
+
+/**
+ * struct ost_node - Tree node referring to one queue element
+ * @elem: indexed element
+ * @prio: random priority, never greater than the one of the parent
+ * @size: number of nodes in the subtree rooted here
+ * @left: subtree of the values sorting before @elem
+ * @right: subtree of the values sorting after or equal to @elem
+ */
+struct ost_node {
+    element_t *elem;
+    uint32_t prio;
+    size_t size;
+    struct ost_node *left, *right;
+};
+
+/**
+ * struct ostree - Index of a queue
+ * @head: header of the indexed queue
+ * @root: root of the treap
+ * @nodes: storage of the nodes, allocated at once when building the tree
+ * @n_nodes: number of nodes in @nodes; those inserted later are allocated
+ *           one by one
+ * @seed: state of the generator drawing node priorities
+ */
+struct ostree {
+    struct list_head *head;
+    struct ost_node *root;
+    struct ost_node *nodes;
+    size_t n_nodes;
+    uintptr_t seed;
+};
+
+/**
+ * ost_new() - Build an index over the elements currently in a queue
+ * @head: header of queue
+ *
+ * Takes O(n log n) time.
+ *
+ * Return: the index, NULL if queue is NULL or allocation failed
+ */
+struct ostree *ost_new(struct list_head *head);
+
+/**
+ * ost_free() - Free the index, leaving the indexed queue untouched
+ * @t: index, no effect if NULL
+ */
+void ost_free(struct ostree *t);
+
+/**
+ * ost_size() - Get the number of indexed elements
+ * @t: index
+ */
+size_t ost_size(const struct ostree *t);
+
+/**
+ * ost_rank() - Count the elements whose value is less than a string
+ * @t: index
+ * @s: string to compare with
+ */
+size_t ost_rank(const struct ostree *t, const char *s);
+
+/**
+ * ost_count() - Count the elements whose value lies in a closed range
+ * @t: index
+ * @lo: lower bound of the range
+ * @hi: upper bound of the range
+ *
+ * Return: the number of elements with @lo <= value <= @hi, zero if @hi < @lo
+ */
+size_t ost_count(const struct ostree *t, const char *lo, const char *hi);
+
+/**
+ * ost_insert() - Index an element just linked into the queue
+ * @t: index
+ * @e: element
+ *
+ * Takes O(log n) time.
+ *
+ * Return: false if allocation failed, which leaves the tree stale
+ */
+bool ost_insert(struct ostree *t, element_t *e);
+
+/**
+ * ost_remove() - Stop indexing an element about to be unlinked from the queue
+ * @t: index
+ * @e: element, left linked and allocated
+ *
+ * Takes O(log n + k) time, k being the number of elements equal to @e.
+ *
+ * Return: false if @e is not indexed
+ */
+bool ost_remove(struct ostree *t, const element_t *e);
+
+/**
+ * ost_delete_range() - Delete the elements whose value lies in a closed range
+ * @t: index
+ * @lo: lower bound of the range
+ * @hi: upper bound of the range
+ *
+ * The elements are unlinked from the queue and freed, while their tree nodes
+ * are only reclaimed by ost_free().  Takes O(log n + k) time for k deleted
+ * elements.
+ *
+ * Return: the number of deleted elements
+ */
+size_t ost_delete_range(struct ostree *t, const char *lo, const char *hi);
+
+#endif /* LAB0_OSTREE_H */
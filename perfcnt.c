@@ -0,0 +1,102 @@
+#include <string.h>
+
+#include "perfcnt.h"
+
+static const char *names[PERFCNT_EVENTS] = {
+    [PERFCNT_CYCLES] = "cycles",
+    [PERFCNT_INSTRUCTIONS] = "instructions",
+    [PERFCNT_CACHE_MISSES] = "cache-misses",
+    [PERFCNT_BRANCH_MISSES] = "branch-misses",
+};
+
+const char *perfcnt_name(enum perfcnt_event ev)
+{
+    return names[ev];
+}
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const uint64_t configs[PERFCNT_EVENTS] = {
+    [PERFCNT_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+    [PERFCNT_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+    [PERFCNT_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    [PERFCNT_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static int open_event(uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool perfcnt_open(struct perfcnt *pc)
+{
+    bool any = false;
+    for (int i = 0; i < PERFCNT_EVENTS; i++) {
+        pc->fd[i] = open_event(configs[i]);
+        pc->value[i] = 0;
+        any = any || pc->fd[i] >= 0;
+    }
+    return any;
+}
+
+void perfcnt_close(struct perfcnt *pc)
+{
+    for (int i = 0; i < PERFCNT_EVENTS; i++) {
+        if (pc->fd[i] >= 0)
+            close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+}
+
+void perfcnt_start(struct perfcnt *pc)
+{
+    for (int i = 0; i < PERFCNT_EVENTS; i++) {
+        if (pc->fd[i] < 0)
+            continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perfcnt_stop(struct perfcnt *pc)
+{
+    for (int i = 0; i < PERFCNT_EVENTS; i++) {
+        if (pc->fd[i] < 0)
+            continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(pc->fd[i], &pc->value[i], sizeof(uint64_t)) !=
+            sizeof(uint64_t))
+            pc->value[i] = 0;
+    }
+}
+
+#else /* perf_event_open(2) is Linux specific */
+
+bool perfcnt_open(struct perfcnt *pc)
+{
+    for (int i = 0; i < PERFCNT_EVENTS; i++) {
+        pc->fd[i] = -1;
+        pc->value[i] = 0;
+    }
+    return false;
+}
+
+void perfcnt_close(struct perfcnt *pc) {}
+
+void perfcnt_start(struct perfcnt *pc) {}
+
+void perfcnt_stop(struct perfcnt *pc) {}
+
+#endif
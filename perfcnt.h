@@ -0,0 +1,77 @@
+#ifndef LAB0_PERFCNT_H
+#define LAB0_PERFCNT_H
+
+/* Hardware performance counters, read through perf_event_open(2).
+ *
+ * Counting is limited to user space in the calling thread.  Counters which
+ * cannot be opened (other platforms, a kernel.perf_event_paranoid setting
+ * too strict, virtual machines without a PMU) are simply reported as
+ * unavailable, so callers can always go through this interface.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum perfcnt_event {
+    PERFCNT_CYCLES,
+    PERFCNT_INSTRUCTIONS,
+    PERFCNT_CACHE_MISSES,
+    PERFCNT_BRANCH_MISSES,
+    PERFCNT_EVENTS,
+};
+
+/**
+ * struct perfcnt - Set of counters
+ * @fd: file descriptor of each counter, negative if it is unavailable
+ * @value: count of each event between the last perfcnt_start() and
+ *         perfcnt_stop()
+ */
+struct perfcnt {
+    int fd[PERFCNT_EVENTS];
+    uint64_t value[PERFCNT_EVENTS];
+};
+
+/**
+ * perfcnt_open() - Open the counters of all the events
+ * @pc: set of counters
+ *
+ * Return: true if at least one counter is available
+ */
+bool perfcnt_open(struct perfcnt *pc);
+
+/**
+ * perfcnt_close() - Close the counters
+ * @pc: set of counters
+ */
+void perfcnt_close(struct perfcnt *pc);
+
+/**
+ * perfcnt_start() - Reset the available counters and start counting
+ * @pc: set of counters
+ */
+void perfcnt_start(struct perfcnt *pc);
+
+/**
+ * perfcnt_stop() - Stop counting and read the counts into @pc->value
+ * @pc: set of counters
+ */
+void perfcnt_stop(struct perfcnt *pc);
+
+/**
+ * perfcnt_valid() - Tell whether an event was counted
+ * @pc: set of counters
+ * @ev: event
+ */
+static inline bool perfcnt_valid(const struct perfcnt *pc,
+                                 enum perfcnt_event ev)
+{
+    return pc->fd[ev] >= 0;
+}
+
+/**
+ * perfcnt_name() - Get the name of an event, such as "cache-misses"
+ * @ev: event
+ */
+const char *perfcnt_name(enum perfcnt_event ev);
+
+#endif /* LAB0_PERFCNT_H */
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pheap.h"
+
+static inline const char *value_of(struct list_head *node)
+{
+    return list_entry(node, element_t, list)->value;
+}
+
+/* Link two heap-ordered trees, the root with the greater value becoming the
+ * leftmost child of the other.  Both roots must have no sibling.
+ */
+static struct list_head *meld(struct list_head *a, struct list_head *b)
+{
+    if (!a || !b)
+        return a ? a : b;
+    if (strcmp(value_of(b), value_of(a)) < 0) {
+        struct list_head *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    b->next = a->prev;
+    a->prev = b;
+    return a;
+}
+
+/* Combine a list of siblings into one tree with the standard two passes:
+ * meld the siblings pairwise from left to right, then meld the resulting
+ * trees from right to left.  The first pass stacks the pairs through their
+ * next links, so that the second one pops them in reverse order.
+ */
+static struct list_head *meld_pairs(struct list_head *first)
+{
+    struct list_head *pairs = NULL;
+    while (first) {
+        struct list_head *a = first, *b = first->next;
+        first = b ? b->next : NULL;
+        a->next = NULL;
+        if (b)
+            b->next = NULL;
+        a = meld(a, b);
+        a->next = pairs;
+        pairs = a;
+    }
+
+    struct list_head *root = NULL;
+    while (pairs) {
+        struct list_head *next = pairs->next;
+        pairs->next = NULL;
+        root = meld(root, pairs);
+        pairs = next;
+    }
+    return root;
+}
+
+void ph_init(struct pheap *h)
+{
+    h->root = NULL;
+    h->size = 0;
+}
+
+bool ph_insert(struct pheap *h, const char *s)
+{
+    element_t *e = malloc(sizeof(element_t));
+    if (!e)
+        return false;
+    e->value = strdup(s);
+    if (!e->value) {
+        free(e);
+        return false;
+    }
+    e->list.next = e->list.prev = NULL;
+    h->root = meld(h->root, &e->list);
+    h->size++;
+    return true;
+}
+
+element_t *ph_min(const struct pheap *h)
+{
+    return h->root ? list_entry(h->root, element_t, list) : NULL;
+}
+
+element_t *ph_remove_min(struct pheap *h, char *sp, size_t bufsize)
+{
+    element_t *e = ph_min(h);
+    if (!e)
+        return NULL;
+    h->root = meld_pairs(e->list.prev);
+    h->size--;
+    INIT_LIST_HEAD(&e->list);
+    if (sp && bufsize) {
+        strncpy(sp, e->value, bufsize - 1);
+        sp[bufsize - 1] = '\0';
+    }
+    return e;
+}
+
+void ph_free(struct pheap *h)
+{
+    /* Free the roots one at a time, splicing the children of each in front
+     * of its siblings, so that no recursion is needed.
+     */
+    struct list_head *node = h->root;
+    while (node) {
+        struct list_head *next = node->next, *child = node->prev;
+        if (child) {
+            struct list_head *last = child;
+            while (last->next)
+                last = last->next;
+            last->next = next;
+            next = child;
+        }
+        q_release_element(list_entry(node, element_t, list));
+        node = next;
+    }
+    ph_init(h);
+}
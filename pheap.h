@@ -0,0 +1,71 @@
+#ifndef LAB0_PHEAP_H
+#define LAB0_PHEAP_H
+
+/* Pairing heap of queue elements, ordered by their strings.
+ *
+ * The heap reuses the list node embedded in every element_t, so no storage
+ * beyond the elements themselves is needed: @next links an element to its
+ * next sibling, and @prev points to its leftmost child.  Insertion takes O(1)
+ * time and removing the minimum O(log n) amortized.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "queue.h"
+
+/**
+ * struct pheap - Priority queue of elements
+ * @root: element holding the smallest string, NULL if the heap is empty
+ * @size: number of elements in the heap
+ */
+struct pheap {
+    struct list_head *root;
+    size_t size;
+};
+
+/**
+ * ph_init() - Initialize an empty heap
+ * @h: heap
+ */
+void ph_init(struct pheap *h);
+
+/**
+ * ph_insert() - Insert an element
+ * @h: heap
+ * @s: string would be inserted
+ *
+ * The string is copied as with q_insert_head().
+ *
+ * Return: true for success, false for allocation failed
+ */
+bool ph_insert(struct pheap *h, const char *s);
+
+/**
+ * ph_min() - Get the element holding the smallest string
+ * @h: heap
+ *
+ * Return: the element, NULL if the heap is empty
+ */
+element_t *ph_min(const struct pheap *h);
+
+/**
+ * ph_remove_min() - Remove the element holding the smallest string
+ * @h: heap
+ * @sp: buffer the removed string is copied to, unless NULL
+ * @bufsize: size of the buffer
+ *
+ * Same contract as q_remove_head(): the element is not freed, and at most
+ * @bufsize - 1 characters plus a null terminator are copied.
+ *
+ * Return: the removed element, NULL if the heap is empty
+ */
+element_t *ph_remove_min(struct pheap *h, char *sp, size_t bufsize);
+
+/**
+ * ph_free() - Free all the elements in the heap, leaving it empty
+ * @h: heap
+ */
+void ph_free(struct pheap *h);
+
+#endif /* LAB0_PHEAP_H */
@@ -3,6 +3,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <signal.h>
 #include <spawn.h>
 #include <stdio.h>
@@ -20,6 +22,7 @@
 #endif
 
 #include "dudect/fixture.h"
+#include "dudect/trace.h"
 #include "list.h"
 #include "random.h"
 
@@ -46,8 +49,14 @@ extern int show_entropy;
  */
 #include "queue.h"
 
+#include "complexity.h"
 #include "console.h"
 #include "report.h"
+#include "order.h"
+#include "ostree.h"
+#include "pheap.h"
+#include "skiplist.h"
+#include "stats.h"
 
 /* Settable parameters */
 
@@ -66,6 +75,16 @@ typedef struct {
     int size;
 } queue_chain_t;
 
+/* Queue of the chain.  A queue created in heap mode keeps its elements in a
+ * pairing heap, and its list stays empty.  The context comes first, so that
+ * the wrapper is freed through a pointer to it.
+ */
+typedef struct {
+    queue_contex_t ctx;
+    bool is_heap;
+    struct pheap heap;
+} qtest_queue_t;
+
 static queue_chain_t chain = {.size = 0};
 static queue_contex_t *current = NULL;
 
@@ -75,15 +94,182 @@ static int fail_count = 0;
 
 static int string_length = MAXSTRING;
 
+/* Does list_sort go through the comparison function pointer? */
+static int list_sort_generic = 0;
+
+/* Order of sort, list_sort and merge: an enum order_mode, and whether it is
+ * reversed
+ */
+static int sort_mode = ORDER_LEX;
+static int sort_descend = 0;
+
+/* Whether to show the memory use on quit, set by option memreport */
+static int mem_on_quit = 0;
+
+/* rank, count and rdel check their answers against a walk of the queue, in
+ * O(n), once every tree_check calls, or never if it is zero
+ */
+static int tree_check = 0;
+static unsigned int tree_calls = 0;
+
+/* Indexes over the current queue: a skip list and an order-statistic tree.
+ * Each is built on demand by the commands that need positional or ordered
+ * access, and both live side by side: the commands going through one of them
+ * pass their changes on to the other.  Every other command modifying a queue
+ * bypasses the indexes and drops them, so that they are rebuilt, in O(n) for
+ * the skip list, O(n log n) for the tree, by the next command using them.
+ */
+static struct skiplist *sl_index = NULL;
+static struct ostree *ost_index = NULL;
+
 #define MIN_RANDSTR_LEN 5
 #define MAX_RANDSTR_LEN 10
-static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
+
+/* Random strings are shorter than rand_length, which option randlen can raise
+ * up to RANDSTR_LEN_LIMIT to test long strings
+ */
+#define RANDSTR_LEN_LIMIT 8192
+static int rand_length = MAX_RANDSTR_LEN;
 
 /* Forward declarations */
 static bool q_show(int vlevel);
 
+static void drop_skiplist()
+{
+    sl_free(sl_index);
+    sl_index = NULL;
+}
+
+static void drop_tree()
+{
+    ost_free(ost_index);
+    ost_index = NULL;
+}
+
+static void drop_index()
+{
+    drop_skiplist();
+    drop_tree();
+}
+
+/* Priority queue of a queue, NULL if it was not created in heap mode */
+static struct pheap *heap_of(queue_contex_t *ctx)
+{
+    qtest_queue_t *qq = container_of(ctx, qtest_queue_t, ctx);
+    return qq->is_heap ? &qq->heap : NULL;
+}
+
+static struct pheap *current_heap()
+{
+    return current ? heap_of(current) : NULL;
+}
+
+/* Reject the commands relying on the list of a queue in heap mode */
+static bool heap_unsupported(const char *cmd)
+{
+    if (!current_heap())
+        return false;
+    report(1, "ERROR: %s is not supported on a priority queue", cmd);
+    return true;
+}
+
+/* Free the elements of a queue, whichever mode it was created in */
+static void release_queue(queue_contex_t *ctx)
+{
+    struct pheap *heap = heap_of(ctx);
+    if (heap)
+        ph_free(heap);
+    q_free(ctx->q);
+}
+
+/* Skip list over the current queue, NULL if it cannot be built */
+static struct skiplist *get_index()
+{
+    if (sl_index && sl_index->head != current->q)
+        drop_skiplist();
+    if (!sl_index)
+        sl_index = sl_new(current->q);
+    return sl_index;
+}
+
+/* Order-statistic tree over the current queue, NULL if it cannot be built */
+static struct ostree *get_tree()
+{
+    if (ost_index && ost_index->head != current->q)
+        drop_tree();
+    if (!ost_index)
+        ost_index = ost_new(current->q);
+    return ost_index;
+}
+
+/* Pass on to the tree an element the skip list linked into the queue, or one
+ * it is about to unlink
+ */
+static void tree_insert(element_t *e)
+{
+    if (ost_index &&
+        (ost_index->head != current->q || !ost_insert(ost_index, e)))
+        drop_tree();
+}
+
+static bool tree_remove(const element_t *e)
+{
+    if (!ost_index || ost_index->head != current->q) {
+        drop_tree();
+    } else if (!ost_remove(ost_index, e)) {
+        report(1, "ERROR: Element %s is not in the order-statistic tree",
+               e->value);
+        drop_tree();
+        return false;
+    }
+    return true;
+}
+
+/* Check in simulation mode whether a queue operation runs in constant time,
+ * or, for one walking the queue, in a time independent of the strings it
+ * holds, on queues of LINEAR_SIZE elements
+ */
+static bool simulate(int argc,
+                     char *argv[],
+                     bool (*is_const)(void),
+                     bool walks)
+{
+    if (argc != 1) {
+        report(1, "%s does not need arguments in simulation mode", argv[0]);
+        return false;
+    }
+    /* Freeing a block in cautious mode walks the blocks of the harness, which
+     * would be timed along with q_release_element() and q_delete_mid()
+     */
+    set_cautious_mode(false);
+    bool ok = is_const();
+    set_cautious_mode(true);
+    if (!ok) {
+        if (walks)
+            report(1,
+                   "ERROR: Probably time dependent on contents at n=%d or "
+                   "wrong implementation",
+                   LINEAR_SIZE);
+        else
+            report(1,
+                   "ERROR: Probably not constant time or wrong "
+                   "implementation");
+        return false;
+    }
+    if (walks)
+        report(1, "Probably time independent of contents at n=%d",
+               LINEAR_SIZE);
+    else
+        report(1, "Probably constant time");
+    return ok;
+}
+
 static bool do_free(int argc, char *argv[])
 {
+    /* q_free releases the elements one by one */
+    if (simulation)
+        return simulate(argc, argv, is_release_element_const, false);
+
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
@@ -100,6 +286,7 @@ static bool do_free(int argc, char *argv[])
     if (current && current->size > BIG_LIST_SIZE)
         set_cautious_mode(false);
 
+    drop_index();
     struct list_head *qnext = NULL;
     if (chain.size > 1) {
         qnext = ((uintptr_t) &current->chain.next == (uintptr_t) &chain.head)
@@ -111,7 +298,7 @@ static bool do_free(int argc, char *argv[])
         list_del(&current->chain);
 
         if (exception_setup(true))
-            q_free(current->q);
+            release_queue(current);
         exception_cancel();
         set_cautious_mode(true);
     }
@@ -136,15 +323,24 @@ static bool do_free(int argc, char *argv[])
 
 static bool do_new(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    bool is_heap = argc == 2 && !strcmp(argv[1], "heap");
+    if (argc == 2 && !is_heap) {
+        report(1, "Unknown queue mode '%s'", argv[1]);
         return false;
     }
 
     bool ok = true;
 
     if (exception_setup(true)) {
-        queue_contex_t *qctx = malloc(sizeof(queue_contex_t));
+        qtest_queue_t *qq = malloc(sizeof(qtest_queue_t));
+        queue_contex_t *qctx = &qq->ctx;
+        qq->is_heap = is_heap;
+        ph_init(&qq->heap);
         list_add_tail(&qctx->chain, &chain.head);
 
         qctx->size = 0;
@@ -159,41 +355,40 @@ static bool do_new(int argc, char *argv[])
     return ok && !error_check();
 }
 
-/* TODO: Add a buf_size check of if the buf_size may be less
- * than MIN_RANDSTR_LEN.
+/* Letters of the random strings, generated a batch at a time */
+#define RAND_LETTERS 4096
+static char rand_letters[RAND_LETTERS];
+static size_t rand_letters_left = 0;
+
+/* A random string shorter than buf_size, which option randlen keeps above
+ * MIN_RANDSTR_LEN
  */
 static void fill_rand_string(char *buf, size_t buf_size)
 {
-    size_t len = 0;
-    while (len < MIN_RANDSTR_LEN)
-        len = rand() % buf_size;
+    size_t len =
+        MIN_RANDSTR_LEN + random_next() % (buf_size - MIN_RANDSTR_LEN);
 
-    randombytes((uint8_t *) buf, len);
-    for (size_t n = 0; n < len; n++)
-        buf[n] = charset[buf[n] % (sizeof(charset) - 1)];
+    if (len > RAND_LETTERS) {
+        random_lowercase(buf, len);
+    } else {
+        if (len > rand_letters_left) {
+            random_lowercase(rand_letters, RAND_LETTERS);
+            rand_letters_left = RAND_LETTERS;
+        }
+        memcpy(buf, rand_letters + RAND_LETTERS - rand_letters_left, len);
+        rand_letters_left -= len;
+    }
     buf[len] = '\0';
 }
 
 /* insert head */
 static bool do_ih(int argc, char *argv[])
 {
-    if (simulation) {
-        if (argc != 1) {
-            report(1, "%s does not need arguments in simulation mode", argv[0]);
-            return false;
-        }
-        bool ok = is_insert_head_const();
-        if (!ok) {
-            report(1,
-                   "ERROR: Probably not constant time or wrong implementation");
-            return false;
-        }
-        report(1, "Probably constant time");
-        return ok;
-    }
+    if (simulation)
+        return simulate(argc, argv, is_insert_head_const, false);
 
     char *lasts = NULL;
-    char randstr_buf[MAX_RANDSTR_LEN];
+    char randstr_buf[RANDSTR_LEN_LIMIT];
     int reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
@@ -218,12 +413,17 @@ static bool do_ih(int argc, char *argv[])
         report(3, "Warning: Calling insert head on null queue");
     error_check();
 
+    drop_index();
+    struct pheap *heap = current_heap();
     if (current && exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
-                fill_rand_string(randstr_buf, sizeof(randstr_buf));
-            bool rval = q_insert_head(current->q, inserts);
-            if (rval) {
+                fill_rand_string(randstr_buf, rand_length);
+            bool rval = heap ? ph_insert(heap, inserts)
+                             : q_insert_head(current->q, inserts);
+            if (rval && heap) {
+                current->size++;
+            } else if (rval) {
                 current->size++;
                 char *cur_inserts =
                     list_entry(current->q->next, element_t, list)->value;
@@ -267,22 +467,10 @@ static bool do_ih(int argc, char *argv[])
 /* insert tail */
 static bool do_it(int argc, char *argv[])
 {
-    if (simulation) {
-        if (argc != 1) {
-            report(1, "%s does not need arguments in simulation mode", argv[0]);
-            return false;
-        }
-        bool ok = is_insert_tail_const();
-        if (!ok) {
-            report(1,
-                   "ERROR: Probably not constant time or wrong implementation");
-            return false;
-        }
-        report(1, "Probably constant time");
-        return ok;
-    }
+    if (simulation)
+        return simulate(argc, argv, is_insert_tail_const, false);
 
-    char randstr_buf[MAX_RANDSTR_LEN];
+    char randstr_buf[RANDSTR_LEN_LIMIT];
     int reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
@@ -307,12 +495,17 @@ static bool do_it(int argc, char *argv[])
         report(3, "Warning: Calling insert tail on null queue");
     error_check();
 
+    drop_index();
+    struct pheap *heap = current_heap();
     if (current && exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
             if (need_rand)
-                fill_rand_string(randstr_buf, sizeof(randstr_buf));
-            bool rval = q_insert_tail(current->q, inserts);
-            if (rval) {
+                fill_rand_string(randstr_buf, rand_length);
+            bool rval = heap ? ph_insert(heap, inserts)
+                             : q_insert_tail(current->q, inserts);
+            if (rval && heap) {
+                current->size++;
+            } else if (rval) {
                 current->size++;
                 char *cur_inserts =
                     list_entry(current->q->prev, element_t, list)->value;
@@ -349,18 +542,9 @@ static bool do_remove(int option, int argc, char *argv[])
      */
 #if !(defined(__aarch64__) && defined(__APPLE__))
     if (simulation) {
-        if (argc != 1) {
-            report(1, "%s does not need arguments in simulation mode", argv[0]);
-            return false;
-        }
-        bool ok = option ? is_remove_tail_const() : is_remove_head_const();
-        if (!ok) {
-            report(1,
-                   "ERROR: Probably not constant time or wrong implementation");
-            return false;
-        }
-        report(1, "Probably constant time");
-        return ok;
+        return simulate(argc, argv,
+                        option ? is_remove_tail_const : is_remove_head_const,
+                        false);
     }
 #endif
 
@@ -369,6 +553,10 @@ static bool do_remove(int option, int argc, char *argv[])
         return false;
     }
 
+    /* A priority queue only gives access to its minimum */
+    if (option && heap_unsupported(argv[0]))
+        return false;
+
     char *removes = malloc(string_length + STRINGPAD + 1);
     if (!removes) {
         report(1,
@@ -399,10 +587,16 @@ static bool do_remove(int option, int argc, char *argv[])
         report(3, "Warning: Calling remove head on empty queue");
     error_check();
 
+    drop_index();
+    struct pheap *heap = current_heap();
     element_t *re = NULL;
-    if (current && exception_setup(true))
-        re = option ? q_remove_tail(current->q, removes, string_length + 1)
-                    : q_remove_head(current->q, removes, string_length + 1);
+    if (current && exception_setup(true)) {
+        if (heap)
+            re = ph_remove_min(heap, removes, string_length + 1);
+        else
+            re = option ? q_remove_tail(current->q, removes, string_length + 1)
+                        : q_remove_head(current->q, removes, string_length + 1);
+    }
     exception_cancel();
 
     bool is_null = re ? false : true;
@@ -433,6 +627,13 @@ static bool do_remove(int option, int argc, char *argv[])
             report(2, "Removed %s from queue", removes);
         }
         current->size--;
+
+        element_t *min = heap ? ph_min(heap) : NULL;
+        if (min && strcmp(min->value, removes) < 0) {
+            report(1, "ERROR: Removed %s while %s is still in the heap",
+                   removes, min->value);
+            ok = false;
+        }
     } else {
         fail_count++;
         if (!check && fail_count < fail_limit) {
@@ -467,6 +668,60 @@ static inline bool do_rt(int argc, char *argv[])
     return do_remove(1, argc, argv);
 }
 
+/* remove head quietly, many times at once when benchmarking */
+static bool do_rhq(int argc, char *argv[])
+{
+    if (argc != 1 && argc != 2) {
+        report(1, "%s needs 0-1 arguments", argv[0]);
+        return false;
+    }
+
+    int reps = 1;
+    if (argc == 2 && !get_int(argv[1], &reps)) {
+        report(1, "Invalid number of removals '%s'", argv[1]);
+        return false;
+    }
+
+    if (!current || current->size < reps)
+        report(3,
+               "Warning: Calling remove head on queue with fewer than %d "
+               "elements",
+               reps);
+    error_check();
+
+    if (current && current->size > BIG_LIST_SIZE)
+        set_cautious_mode(false);
+
+    drop_index();
+    struct pheap *heap = current_heap();
+    bool ok = true;
+    if (current && exception_setup(true)) {
+        for (int r = 0; ok && r < reps; r++) {
+            element_t *re = heap ? ph_remove_min(heap, NULL, 0)
+                                 : q_remove_head(current->q, NULL, 0);
+            if (!re) {
+                report(1, "ERROR: Removal from queue failed");
+                ok = false;
+                break;
+            }
+            current->size--;
+            element_t *min = heap ? ph_min(heap) : NULL;
+            if (min && strcmp(min->value, re->value) < 0) {
+                report(1, "ERROR: Removed %s while %s is still in the heap",
+                       re->value, min->value);
+                ok = false;
+            }
+            q_release_element(re);
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+    set_cautious_mode(true);
+
+    q_show(3);
+    return ok && !error_check();
+}
+
 static bool do_dedup(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -474,6 +729,10 @@ static bool do_dedup(int argc, char *argv[])
         return false;
     }
 
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    drop_index();
     LIST_HEAD(l_copy);
     element_t *item = NULL, *tmp = NULL;
 
@@ -564,10 +823,14 @@ static bool do_reverse(int argc, char *argv[])
         return false;
     }
 
+    if (heap_unsupported(argv[0]))
+        return false;
+
     if (!current || !current->q)
         report(3, "Warning: Calling reverse on null queue");
     error_check();
 
+    drop_index();
     set_noallocate_mode(true);
     if (current && exception_setup(true))
         q_reverse(current->q);
@@ -580,6 +843,13 @@ static bool do_reverse(int argc, char *argv[])
 
 static bool do_size(int argc, char *argv[])
 {
+    if (simulation) {
+        report(1, "%s is not simulated: q_size reads no string, and how its "
+                  "time grows is shown by 'complexity size'",
+               argv[0]);
+        return false;
+    }
+
     if (argc != 1 && argc != 2) {
         report(1, "%s takes 0-1 arguments", argv[0]);
         return false;
@@ -602,113 +872,591 @@ static bool do_size(int argc, char *argv[])
         report(3, "Warning: Calling size on null queue");
     error_check();
 
+    struct pheap *heap = current_heap();
     if (current && exception_setup(true)) {
         for (int r = 0; ok && r < reps; r++) {
-            cnt = q_size(current->q);
+            cnt = heap ? (int) heap->size : q_size(current->q);
             ok = ok && !error_check();
         }
     }
     exception_cancel();
 
-    if (current && ok) {
-        if (current->size == cnt) {
-            report(2, "Queue size = %d", cnt);
-        } else {
+    if (current && ok) {
+        if (current->size == cnt) {
+            report(2, "Queue size = %d", cnt);
+        } else {
+            report(1,
+                   "ERROR: Computed queue size as %d, but correct value is %d",
+                   cnt, (int) current->size);
+            ok = false;
+        }
+    }
+
+    q_show(3);
+
+    return ok && !error_check();
+}
+
+/* Order selected by the sortmode and descend options, NULL for the default
+ * ascending one
+ */
+static const struct order *sort_order()
+{
+    static struct order o;
+    if (sort_mode == ORDER_LEX && !sort_descend)
+        return NULL;
+    o.mode = sort_mode;
+    o.descend = sort_descend;
+    return &o;
+}
+
+static const char *order_desc()
+{
+    static const char *desc[ORDER_MODES][2] = {
+        [ORDER_LEX] = {"ascending", "descending"},
+        [ORDER_LENGTH] = {"ascending length", "descending length"},
+        [ORDER_NATURAL] = {"ascending natural", "descending natural"},
+    };
+    return desc[sort_mode][!!sort_descend];
+}
+
+/* Are the first cnt elements of queue in the selected order? */
+static bool is_sorted(struct list_head *head, int cnt)
+{
+    const struct order *o = sort_order();
+    for (struct list_head *cur_l = head->next; cur_l != head && --cnt;
+         cur_l = cur_l->next) {
+        element_t *item, *next_item;
+        item = list_entry(cur_l, element_t, list);
+        next_item = list_entry(cur_l->next, element_t, list);
+        if (order_cmp(o, item->value, next_item->value) > 0)
+            return false;
+    }
+    return true;
+}
+
+static void set_sort_mode(int oldval)
+{
+    if (sort_mode < 0 || sort_mode >= ORDER_MODES) {
+        report(1, "Invalid sort mode %d, should be 0-%d", sort_mode,
+               ORDER_MODES - 1);
+        sort_mode = oldval;
+    }
+}
+
+static void set_rand_length(int oldval)
+{
+    if (rand_length <= MIN_RANDSTR_LEN || rand_length > RANDSTR_LEN_LIMIT) {
+        report(1, "Invalid random string length %d, should be %d-%d",
+               rand_length, MIN_RANDSTR_LEN + 1, RANDSTR_LEN_LIMIT);
+        rand_length = oldval;
+    }
+}
+
+static void set_dudect_workers(int oldval)
+{
+    int max = dudect_max_workers();
+    if (dudect_workers < 1 || dudect_workers > max) {
+        report(1, "Invalid number of workers %d, should be 1-%d",
+               dudect_workers, max);
+        dudect_workers = oldval;
+    }
+}
+
+static bool do_ctstate(int argc, char *argv[])
+{
+    if (argc > 2) {
+        report(1, "%s takes at most one argument", argv[0]);
+        return false;
+    }
+
+    if (!dudect_set_state(argc == 2 ? argv[1] : NULL)) {
+        report(1, "'%s' does not hold statistics of constant time tests",
+               argv[1]);
+        return false;
+    }
+    return true;
+}
+
+static bool do_ctmerge(int argc, char *argv[])
+{
+    if (argc < 2) {
+        report(1, "%s needs at least one file", argv[0]);
+        return false;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        bool partial;
+        int merged = dudect_merge_state(argv[i], &partial);
+        if (merged < 0) {
+            report(1, "Cannot merge '%s' into the ctstate file", argv[i]);
+            return false;
+        }
+        report(1, "Merged %d operations from '%s'", merged, argv[i]);
+        if (partial)
+            report(1, "Some of them were cropped at other thresholds, only "
+                      "their raw and second order tests were merged");
+    }
+    return true;
+}
+
+static bool do_cttrace(int argc, char *argv[])
+{
+    if (argc > 2) {
+        report(1, "%s takes at most one argument", argv[0]);
+        return false;
+    }
+
+    if (argc == 1) {
+        ct_trace_close();
+        return true;
+    }
+    if (!ct_trace_open(argv[1])) {
+        report(1, "Couldn't map trace file '%s'", argv[1]);
+        return false;
+    }
+    return true;
+}
+
+/* Measurements between two lines streamed by default */
+#define CTSTREAM_EVERY 1000
+
+static bool do_ctstream(int argc, char *argv[])
+{
+    if (argc > 3) {
+        report(1, "%s takes at most 2 arguments", argv[0]);
+        return false;
+    }
+
+    int every = CTSTREAM_EVERY;
+    if (argc == 3 && (!get_int(argv[2], &every) || every < 1)) {
+        report(1, "Invalid number of measurements '%s'", argv[2]);
+        return false;
+    }
+
+    if (!dudect_set_stream(argc >= 2 ? argv[1] : NULL, every)) {
+        report(1, "Couldn't open stream file '%s'", argv[1]);
+        return false;
+    }
+    return true;
+}
+
+static int value_cmp(void *priv,
+                     const struct list_head *a,
+                     const struct list_head *b)
+{
+    return order_cmp(priv, list_entry(a, element_t, list)->value,
+                     list_entry(b, element_t, list)->value);
+}
+
+static LIST_SORT_DEFINE(list_sort_value, value_cmp);
+
+bool do_list_sort(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    int cnt = 0;
+    if (!current || !current->q)
+        report(3, "Warning: Calling sort on null queue");
+    else
+        cnt = q_size(current->q);
+    error_check();
+
+    if (cnt < 2)
+        report(3, "Warning: Calling sort on single node");
+    error_check();
+
+    drop_index();
+    set_noallocate_mode(true);
+    if (current && exception_setup(true)) {
+        void *o = (void *) sort_order();
+        if (list_sort_generic)
+            list_sort(o, current->q, value_cmp);
+        else
+            list_sort_value(o, current->q);
+    }
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    bool ok = true;
+    if (current && current->size && !is_sorted(current->q, cnt)) {
+        report(1, "ERROR: Not sorted in %s order", order_desc());
+        ok = false;
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+bool do_sort(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    int cnt = 0;
+    if (!current || !current->q)
+        report(3, "Warning: Calling sort on null queue");
+    else
+        cnt = q_size(current->q);
+    error_check();
+
+    if (cnt < 2)
+        report(3, "Warning: Calling sort on single node");
+    error_check();
+
+    drop_index();
+    set_noallocate_mode(true);
+    if (current && exception_setup(true))
+        q_sort_by(current->q, sort_order());
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    bool ok = true;
+    if (current && current->size && !is_sorted(current->q, cnt)) {
+        report(1, "ERROR: Not sorted in %s order", order_desc());
+        ok = false;
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+static bool do_dm(int argc, char *argv[])
+{
+    if (simulation)
+        return simulate(argc, argv, is_delete_mid_const, true);
+
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    if (!current || !current->q)
+        report(3, "Warning: Try to access null queue");
+    error_check();
+
+    /* Keep the indexes in step if there is a skip list for this queue */
+    if (!sl_index || sl_index->head != current->q)
+        drop_index();
+
+    bool ok = true;
+    if (exception_setup(true)) {
+        if (sl_index) {
+            element_t *mid = sl_at(sl_index, sl_index->size / 2);
+            ok = (!mid || tree_remove(mid)) && sl_delete_mid(sl_index);
+        } else {
+            ok = q_delete_mid(current->q);
+        }
+    }
+    exception_cancel();
+
+    current->size--;
+    q_show(3);
+    return ok && !error_check();
+}
+
+/* insert in sorted position, through the skip list index */
+static bool do_isort(int argc, char *argv[])
+{
+    int reps = 1;
+    bool ok = true;
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    char *inserts = argv[1];
+    if (argc == 3) {
+        if (!get_int(argv[2], &reps)) {
+            report(1, "Invalid number of insertions '%s'", argv[2]);
+            return false;
+        }
+    }
+
+    if (!current || !current->q)
+        report(3, "Warning: Calling insert sorted on null queue");
+    error_check();
+
+    if (current && exception_setup(true)) {
+        struct skiplist *sl = get_index();
+        if (!sl) {
+            report(1, "ERROR: Could not build skip list index");
+            ok = false;
+        }
+        for (int r = 0; ok && r < reps; r++) {
+            element_t *e = sl_insert_sorted(sl, inserts);
+            if (e) {
+                current->size++;
+                tree_insert(e);
+                /* The new element must sit in the list where the index
+                 * placed it: after no greater value, before a greater one.
+                 */
+                struct list_head *prev = e->list.prev, *next = e->list.next;
+                if ((prev != current->q &&
+                     strcmp(list_entry(prev, element_t, list)->value,
+                            inserts) > 0) ||
+                    (next != current->q &&
+                     strcmp(list_entry(next, element_t, list)->value,
+                            inserts) <= 0)) {
+                    report(1, "ERROR: Inserted %s out of sorted position",
+                           inserts);
+                    ok = false;
+                }
+            } else {
+                fail_count++;
+                if (fail_count < fail_limit)
+                    report(2, "Insertion of %s failed", inserts);
+                else {
+                    report(1,
+                           "ERROR: Insertion of %s failed (%d failures total)",
+                           inserts, fail_count);
+                    ok = false;
+                }
+            }
+            ok = ok && !error_check();
+        }
+    }
+    exception_cancel();
+
+    q_show(3);
+    return ok;
+}
+
+/* remove at index, through the skip list index */
+static bool do_ri(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    int idx = 0;
+    if (!get_int(argv[1], &idx) || idx < 0) {
+        report(1, "Invalid index '%s'", argv[1]);
+        return false;
+    }
+
+    if (!current || !current->size)
+        report(3, "Warning: Calling remove index on empty queue");
+    error_check();
+
+    bool ok = true;
+    element_t *re = NULL;
+    if (current && exception_setup(true)) {
+        struct skiplist *sl = get_index();
+        if (sl) {
+            re = sl_remove_at(sl, idx);
+            if (re && !tree_remove(re))
+                ok = false;
+        } else {
+            report(1, "ERROR: Could not build skip list index");
+            ok = false;
+        }
+    }
+    exception_cancel();
+
+    if (re) {
+        report(2, "Removed %s from queue", re->value);
+        if (argc == 3 && strcmp(re->value, argv[2])) {
+            report(1, "ERROR: Removed value %s != expected value %s",
+                   re->value, argv[2]);
+            ok = false;
+        }
+        q_release_element(re);
+        current->size--;
+    } else if (ok && current) {
+        report(1, "ERROR: No element at index %d", idx);
+        ok = false;
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
+/* Is this call of a tree command one to check, as set by option treecheck? */
+static bool tree_check_due()
+{
+    return tree_check > 0 && ++tree_calls % (unsigned int) tree_check == 0;
+}
+
+/* Count the elements of the current queue with lo <= value <= hi by walking
+ * it, to check the answers of the order-statistic tree.
+ */
+static int count_in_range(const char *lo, const char *hi)
+{
+    int cnt = 0;
+    element_t *item;
+    list_for_each_entry (item, current->q, list) {
+        if (strcmp(item->value, lo) >= 0 && strcmp(item->value, hi) <= 0)
+            cnt++;
+    }
+    return cnt;
+}
+
+/* count the elements less and greater than str, through the tree */
+static bool do_rank(int argc, char *argv[])
+{
+    if (argc != 2) {
+        report(1, "%s needs 1 argument", argv[0]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    if (!current || !current->q)
+        report(3, "Warning: Calling rank on null queue");
+    error_check();
+
+    bool ok = true;
+    int less = 0, greater = 0;
+    if (current && exception_setup(true)) {
+        struct ostree *t = get_tree();
+        if (t) {
+            size_t equal = ost_count(t, argv[1], argv[1]);
+            less = ost_rank(t, argv[1]);
+            greater = ost_size(t) - less - equal;
+        } else {
+            report(1, "ERROR: Could not build order-statistic tree");
+            ok = false;
+        }
+    }
+    exception_cancel();
+
+    if (current && ok && tree_check_due()) {
+        int exp_less = 0, exp_greater = 0;
+        element_t *item;
+        list_for_each_entry (item, current->q, list) {
+            int c = strcmp(item->value, argv[1]);
+            exp_less += c < 0;
+            exp_greater += c > 0;
+        }
+        if (less != exp_less || greater != exp_greater) {
             report(1,
-                   "ERROR: Computed queue size as %d, but correct value is %d",
-                   cnt, (int) current->size);
+                   "ERROR: Computed %d elements less and %d greater than %s, "
+                   "but correct values are %d and %d",
+                   less, greater, argv[1], exp_less, exp_greater);
             ok = false;
         }
     }
+    if (current && ok)
+        report(2, "%d elements less than %s, %d greater", less, argv[1],
+               greater);
 
     q_show(3);
-
     return ok && !error_check();
 }
 
-bool do_list_sort(int argc, char *argv[])
+/* count the elements within a range of values, through the tree */
+static bool do_count(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    if (argc != 3) {
+        report(1, "%s needs 2 arguments", argv[0]);
         return false;
     }
 
-    int cnt = 0;
-    if (!current || !current->q)
-        report(3, "Warning: Calling sort on null queue");
-    else
-        cnt = q_size(current->q);
-    error_check();
+    if (heap_unsupported(argv[0]))
+        return false;
 
-    if (cnt < 2)
-        report(3, "Warning: Calling sort on single node");
+    if (!current || !current->q)
+        report(3, "Warning: Calling count on null queue");
     error_check();
 
-    set_noallocate_mode(true);
-    if (current && exception_setup(true))
-        list_sort(current->q);
+    bool ok = true;
+    int cnt = 0;
+    if (current && exception_setup(true)) {
+        struct ostree *t = get_tree();
+        if (t)
+            cnt = ost_count(t, argv[1], argv[2]);
+        else {
+            report(1, "ERROR: Could not build order-statistic tree");
+            ok = false;
+        }
+    }
     exception_cancel();
-    set_noallocate_mode(false);
 
-    bool ok = true;
-    if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
-            /* Ensure each element in ascending order */
-            /* FIXME: add an option to specify sorting order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) > 0) {
-                report(1, "ERROR: Not sorted in ascending order");
-                ok = false;
-                break;
-            }
+    if (current && ok && tree_check_due()) {
+        int expected = count_in_range(argv[1], argv[2]);
+        if (cnt != expected) {
+            report(1,
+                   "ERROR: Computed %d elements between %s and %s, but "
+                   "correct value is %d",
+                   cnt, argv[1], argv[2], expected);
+            ok = false;
         }
     }
+    if (current && ok)
+        report(2, "%d elements between %s and %s", cnt, argv[1], argv[2]);
 
     q_show(3);
     return ok && !error_check();
 }
 
-bool do_sort(int argc, char *argv[])
+/* delete the elements within a range of values, through the tree */
+static bool do_rdel(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    if (argc != 3) {
+        report(1, "%s needs 2 arguments", argv[0]);
         return false;
     }
 
-    int cnt = 0;
+    if (heap_unsupported(argv[0]))
+        return false;
+
     if (!current || !current->q)
-        report(3, "Warning: Calling sort on null queue");
-    else
-        cnt = q_size(current->q);
+        report(3, "Warning: Calling range delete on null queue");
     error_check();
 
-    if (cnt < 2)
-        report(3, "Warning: Calling sort on single node");
-    error_check();
+    /* Elements are released from anywhere in the queue */
+    if (current && current->size > BIG_LIST_SIZE)
+        set_cautious_mode(false);
 
-    set_noallocate_mode(true);
-    if (current && exception_setup(true))
-        q_sort(current->q);
+    bool ok = true;
+    int cnt = 0;
+    if (current && exception_setup(true)) {
+        struct ostree *t = get_tree();
+        if (t)
+            cnt = ost_delete_range(t, argv[1], argv[2]);
+        else {
+            report(1, "ERROR: Could not build order-statistic tree");
+            ok = false;
+        }
+    }
     exception_cancel();
-    set_noallocate_mode(false);
+    set_cautious_mode(true);
 
-    bool ok = true;
-    if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --cnt; cur_l = cur_l->next) {
-            /* Ensure each element in ascending order */
-            /* FIXME: add an option to specify sorting order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) > 0) {
-                report(1, "ERROR: Not sorted in ascending order");
-                ok = false;
-                break;
-            }
+    /* The skip list cannot tell the positions of the deleted elements */
+    if (cnt)
+        drop_skiplist();
+
+    if (current && ok) {
+        current->size -= cnt;
+        report(2, "Deleted %d elements between %s and %s", cnt, argv[1],
+               argv[2]);
+        if (tree_check_due() && count_in_range(argv[1], argv[2])) {
+            report(1, "ERROR: Elements between %s and %s are still in queue",
+                   argv[1], argv[2]);
+            ok = false;
         }
     }
 
@@ -716,38 +1464,76 @@ bool do_sort(int argc, char *argv[])
     return ok && !error_check();
 }
 
-static bool do_dm(int argc, char *argv[])
+/* Swap the strings of n random pairs of elements, leaving the list links
+ * alone.  This turns a sorted queue into a nearly sorted one.
+ */
+static bool do_perturb(int argc, char *argv[])
 {
-    if (argc != 1) {
-        report(1, "%s takes no arguments", argv[0]);
+    if (argc != 2) {
+        report(1, "%s needs 1 argument", argv[0]);
         return false;
     }
 
-    if (!current || !current->q)
-        report(3, "Warning: Try to access null queue");
+    int reps = 0;
+    if (!get_int(argv[1], &reps) || reps < 0) {
+        report(1, "Invalid number of swaps '%s'", argv[1]);
+        return false;
+    }
+
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    if (!current || current->size < 2) {
+        report(3,
+               "Warning: Calling perturb on queue with fewer than 2 elements");
+        return !error_check();
+    }
     error_check();
 
-    bool ok = true;
-    if (exception_setup(true))
-        ok = q_delete_mid(current->q);
-    exception_cancel();
+    element_t **elems = malloc(current->size * sizeof(element_t *));
+    if (!elems) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for elements");
+        return false;
+    }
+
+    drop_index();
+    int n = 0;
+    element_t *e;
+    list_for_each_entry (e, current->q, list) {
+        if (n == current->size)
+            break;
+        elems[n++] = e;
+    }
+    for (int r = 0; n > 1 && r < reps; r++) {
+        element_t *a = elems[random_next() % n], *b = elems[random_next() % n];
+        char *tmp = a->value;
+        a->value = b->value;
+        b->value = tmp;
+    }
+    free(elems);
 
-    current->size--;
     q_show(3);
-    return ok && !error_check();
+    return !error_check();
 }
 
 static bool do_swap(int argc, char *argv[])
 {
+    if (simulation)
+        return simulate(argc, argv, is_swap_const, true);
+
     if (argc != 1) {
         report(1, "%s takes no arguments", argv[0]);
         return false;
     }
 
+    if (heap_unsupported(argv[0]))
+        return false;
+
     if (!current || !current->q)
         report(3, "Warning: Try to access null queue");
     error_check();
 
+    drop_index();
     set_noallocate_mode(true);
     if (exception_setup(true))
         q_swap(current->q);
@@ -766,6 +1552,9 @@ static bool do_descend(int argc, char *argv[])
         return false;
     }
 
+    if (heap_unsupported(argv[0]))
+        return false;
+
     if (!current || !current->q)
         report(3, "Warning: Calling ascend on null queue");
     error_check();
@@ -776,6 +1565,7 @@ static bool do_descend(int argc, char *argv[])
         report(3, "Warning: Calling ascend on single node");
     error_check();
 
+    drop_index();
     if (exception_setup(true))
         current->size = q_descend(current->q);
     set_noallocate_mode(false);
@@ -821,6 +1611,10 @@ static bool do_reverseK(int argc, char *argv[])
         return false;
     }
 
+    if (heap_unsupported(argv[0]))
+        return false;
+
+    drop_index();
     set_noallocate_mode(true);
     if (exception_setup(true))
         q_reverseK(current->q, k);
@@ -844,10 +1638,20 @@ static bool do_merge(int argc, char *argv[])
     }
     error_check();
 
+    queue_contex_t *qctx;
+    list_for_each_entry (qctx, &chain.head, chain) {
+        if (heap_of(qctx)) {
+            report(1, "ERROR: %s is not supported on a priority queue",
+                   argv[0]);
+            return false;
+        }
+    }
+
+    drop_index();
     int len = 0;
     set_noallocate_mode(true);
     if (current && exception_setup(true))
-        len = q_merge(&chain.head);
+        len = q_merge_by(&chain.head, sort_order());
     exception_cancel();
     set_noallocate_mode(false);
 
@@ -869,22 +1673,12 @@ static bool do_merge(int argc, char *argv[])
     }
 
     bool ok = true;
-    if (current && current->size) {
-        for (struct list_head *cur_l = current->q->next;
-             cur_l != current->q && --len; cur_l = cur_l->next) {
-            /* Ensure each element in ascending order */
-            element_t *item, *next_item;
-            item = list_entry(cur_l, element_t, list);
-            next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) > 0) {
-                report(1,
-                       "ERROR: Not sorted in ascending order (It might because "
-                       "of unsorted queues are merged or there're some flaws "
-                       "in 'q_merge')");
-                ok = false;
-                break;
-            }
-        }
+    if (current && current->size && !is_sorted(current->q, len)) {
+        report(1,
+               "ERROR: Not sorted in %s order (It might because of unsorted "
+               "queues are merged or there're some flaws in 'q_merge')",
+               order_desc());
+        ok = false;
     }
 
     q_show(3);
@@ -921,6 +1715,16 @@ static bool q_show(int vlevel)
         return true;
     }
 
+    struct pheap *heap = current_heap();
+    if (heap) {
+        if (heap->size)
+            report(vlevel, "h = [%s%s]", ph_min(heap)->value,
+                   heap->size > 1 ? " ..." : "");
+        else
+            report(vlevel, "h = []");
+        return true;
+    }
+
     if (!is_circular()) {
         report(vlevel, "ERROR:  Queue is not doubly circular");
         return false;
@@ -1028,9 +1832,391 @@ static bool do_next(int argc, char *argv[])
     return q_show(0);
 }
 
+/* Number of elements in all the queues */
+static int total_elements(void)
+{
+    int n = 0;
+    queue_contex_t *ctx;
+    list_for_each_entry (ctx, &chain.head, chain)
+        n += ctx->size;
+    return n;
+}
+
+#ifdef QUEUE_STATS
+/* Counters when the current command line started */
+static struct queue_stats stats_start;
+
+static void stats_before(int argc, char *argv[])
+{
+    stats_start = queue_stats;
+}
+
+/* At verbosity level 4 and above, report the work of every command line
+ * which ran queue code
+ */
+static void stats_after(int argc, char *argv[])
+{
+    uint64_t cmps = queue_stats.cmps - stats_start.cmps;
+    uint64_t visits = queue_stats.visits - stats_start.visits;
+    uint64_t writes = queue_stats.writes - stats_start.writes;
+    if (cmps || visits || writes)
+        report(4,
+               "%s: %" PRIu64 " comparisons, %" PRIu64 " visits, %" PRIu64
+               " writes",
+               argv[0], cmps, visits, writes);
+}
+#endif
+
+/* Largest queue size of the complexity command by default */
+#define COMPLEXITY_MAX_SIZE (4 << 20)
+
+static bool do_complexity(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 4) {
+        report(1, "%s needs 1-3 arguments", argv[0]);
+        return false;
+    }
+
+    int max_size = COMPLEXITY_MAX_SIZE;
+    if (argc >= 3 && !get_int(argv[2], &max_size)) {
+        report(1, "Invalid largest size '%s'", argv[2]);
+        return false;
+    }
+    int expect = argc == 4 ? cx_parse_class(argv[3]) : -1;
+    if (argc == 4 && expect < 0) {
+        report(1, "Invalid class '%s', should be one of: 1 logn n nlogn n2",
+               argv[3]);
+        return false;
+    }
+
+    /* The queues are large, and the blocks are freed out of order */
+    set_cautious_mode(false);
+    bool ok = false;
+    if (exception_setup(false))
+        ok = cx_measure(argv[1], max_size, expect);
+    exception_cancel();
+    set_cautious_mode(true);
+
+    return ok && !error_check();
+}
+
+static bool do_stats(int argc, char *argv[])
+{
+    if (argc > 2 || (argc == 2 && strcmp(argv[1], "reset"))) {
+        report(1, "%s takes no arguments, or 'reset'", argv[0]);
+        return false;
+    }
+
+#ifdef QUEUE_STATS
+    if (argc == 2) {
+        memset(&queue_stats, 0, sizeof(queue_stats));
+        stats_start = queue_stats;
+        return true;
+    }
+    report(1, "Comparisons = %" PRIu64, queue_stats.cmps);
+    report(1, "Visits = %" PRIu64, queue_stats.visits);
+    report(1, "Writes = %" PRIu64, queue_stats.writes);
+    return true;
+#else
+    report(1, "Queue statistics are not compiled in.  Build with "
+              "'make STATS=1'");
+    return false;
+#endif
+}
+
+/* With -j, every command line is recorded as a JSON object on a line of its
+ * own, for scripts/driver.py to aggregate
+ */
+static FILE *json_file = NULL;
+
+/* Time and allocations when the current command line started */
+static uint64_t cmd_start;
+static size_t cmd_start_allocs;
+
+/* Allocations made by each command, for the mem command */
+#define MAX_MEM_CMDS 64
+static struct {
+    char name[16];
+    uint64_t runs, allocs, ns;
+} mem_cmds[MAX_MEM_CMDS];
+static int mem_cmd_cnt = 0;
+
+static void mem_record(const char *name, size_t allocs, uint64_t ns)
+{
+    int i = 0;
+    while (i < mem_cmd_cnt && strncmp(mem_cmds[i].name, name,
+                                      sizeof(mem_cmds[i].name) - 1))
+        i++;
+    if (i == mem_cmd_cnt) {
+        if (mem_cmd_cnt == MAX_MEM_CMDS)
+            return;
+        strncpy(mem_cmds[i].name, name, sizeof(mem_cmds[i].name) - 1);
+        mem_cmd_cnt++;
+    }
+    mem_cmds[i].runs++;
+    mem_cmds[i].allocs += allocs;
+    mem_cmds[i].ns += ns;
+}
+
+/* Resident set size of the process, and its peak, in kB */
+static bool process_rss(size_t *rss, size_t *peak)
+{
+#if defined(__linux__)
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return false;
+    char line[128];
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %zu", rss) == 1 ||
+            sscanf(line, "VmHWM: %zu", peak) == 1)
+            found++;
+    }
+    fclose(f);
+    return found == 2;
+#else
+    return false;
+#endif
+}
+
+/* Report the memory of the queues, of the interpreter and of the process */
+static void mem_report(int vlevel)
+{
+    mem_stats_t ms;
+    mem_stats(&ms);
+    report(vlevel,
+           "Queue memory: %zu blocks, %zu bytes, peak %zu bytes, %zu "
+           "allocations",
+           ms.blocks, ms.bytes, ms.peak_bytes, ms.allocs);
+    size_t current, peak, count;
+    alloc_usage(&current, &peak, &count);
+    report(vlevel, "Interpreter memory: %zu bytes, peak %zu bytes, %zu "
+                   "allocations",
+           current, peak, count);
+    size_t rss, rss_peak;
+    if (process_rss(&rss, &rss_peak))
+        report(vlevel, "Process memory: RSS %zu kB, peak %zu kB", rss,
+               rss_peak);
+}
+
+/* Most threads of the mtalloc command */
+#define MTALLOC_MAX_THREADS 64
+
+/**
+ * struct mtalloc_run - State shared by the threads of the mtalloc command
+ * @lock: guards @state
+ * @cond: signaled when @state changes
+ * @state: MTALLOC_WAIT until every thread is created, then MTALLOC_GO, or
+ *         MTALLOC_ABORT if one could not be
+ * @barrier: between allocating and freeing, for the threads created
+ */
+struct mtalloc_run {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    enum { MTALLOC_WAIT, MTALLOC_GO, MTALLOC_ABORT } state;
+    pthread_barrier_t barrier;
+};
+
+struct mtalloc_worker {
+    pthread_t thread;
+    struct mtalloc_run *run;
+    void **blocks;
+    int n;
+    struct mtalloc_worker *next; /* Worker whose blocks this one frees */
+};
+
+/* Allocate blocks, freeing every other one right away, then free those the
+ * next worker kept: all of them end up released by another thread.
+ */
+static void *mtalloc_worker(void *arg)
+{
+    struct mtalloc_worker *w = arg;
+    struct mtalloc_run *run = w->run;
+
+    pthread_mutex_lock(&run->lock);
+    while (run->state == MTALLOC_WAIT)
+        pthread_cond_wait(&run->cond, &run->lock);
+    bool go = run->state == MTALLOC_GO;
+    pthread_mutex_unlock(&run->lock);
+    if (!go)
+        return NULL;
+
+    for (int i = 0; i < w->n; i++) {
+        w->blocks[i] = test_malloc(1 + i % 64);
+        if (w->blocks[i])
+            memset(w->blocks[i], i, 1 + i % 64);
+        if (i & 1) {
+            test_free(w->blocks[i]);
+            w->blocks[i] = NULL;
+        }
+    }
+    pthread_barrier_wait(&run->barrier);
+    for (int i = 0; i < w->n; i++)
+        test_free(w->next->blocks[i]);
+    return NULL;
+}
+
+static bool do_mtalloc(int argc, char *argv[])
+{
+    if (argc != 2 && argc != 3) {
+        report(1, "%s needs 1-2 arguments", argv[0]);
+        return false;
+    }
+
+    int n, threads = 4;
+    if (!get_int(argv[1], &n) || n < 0) {
+        report(1, "Invalid number of blocks '%s'", argv[1]);
+        return false;
+    }
+    if (argc == 3 && (!get_int(argv[2], &threads) || threads < 1 ||
+                      threads > MTALLOC_MAX_THREADS)) {
+        report(1, "Number of threads should be 1-%d", MTALLOC_MAX_THREADS);
+        return false;
+    }
+
+    struct mtalloc_run run = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .state = MTALLOC_WAIT,
+    };
+    struct mtalloc_worker workers[MTALLOC_MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (struct mtalloc_worker){
+            .run = &run,
+            .n = n,
+            .next = &workers[(t + 1) % threads],
+        };
+    }
+
+    size_t before = allocation_check();
+    bool ok = true;
+    for (int t = 0; ok && t < threads; t++) {
+        workers[t].blocks = calloc(n + 1, sizeof(void *));
+        if (!workers[t].blocks) {
+            report(1, "Cannot allocate the blocks of %d threads", threads);
+            ok = false;
+        }
+    }
+
+    /* The threads wait until all of them are created, or told to quit */
+    int started = 0;
+    for (; ok && started < threads; started++) {
+        if (pthread_create(&workers[started].thread, NULL, mtalloc_worker,
+                           &workers[started])) {
+            report(1, "Cannot create %d threads", threads);
+            ok = false;
+            break;
+        }
+    }
+    if (ok)
+        pthread_barrier_init(&run.barrier, NULL, threads);
+    pthread_mutex_lock(&run.lock);
+    run.state = ok ? MTALLOC_GO : MTALLOC_ABORT;
+    pthread_cond_broadcast(&run.cond);
+    pthread_mutex_unlock(&run.lock);
+
+    for (int t = 0; t < started; t++)
+        pthread_join(workers[t].thread, NULL);
+    if (ok)
+        pthread_barrier_destroy(&run.barrier);
+    for (int t = 0; t < threads; t++)
+        free(workers[t].blocks);
+
+    size_t after = allocation_check();
+    if (ok && after != before) {
+        report(1, "ERROR: %zu blocks allocated before, %zu after", before,
+               after);
+        ok = false;
+    }
+    return ok && !error_check();
+}
+
+static bool do_mem(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    mem_report(1);
+    report(1, "%-12s %8s %12s %14s", "Command", "Runs", "Allocations",
+           "Allocations/s");
+    for (int i = 0; i < mem_cmd_cnt; i++) {
+        if (!mem_cmds[i].allocs)
+            continue;
+        double secs = mem_cmds[i].ns * 1e-9;
+        report(1, "%-12s %8" PRIu64 " %12" PRIu64 " %14.0f", mem_cmds[i].name,
+               mem_cmds[i].runs, mem_cmds[i].allocs,
+               secs > 0 ? mem_cmds[i].allocs / secs : 0.0);
+    }
+    return true;
+}
+
+static void json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static void json_record(int argc,
+                        char *argv[],
+                        uint64_t ns,
+                        const mem_stats_t *ms,
+                        size_t allocs)
+{
+    fputs("{\"cmd\": ", json_file);
+    json_string(json_file, argv[0]);
+    fputs(", \"args\": [", json_file);
+    for (int i = 1; i < argc; i++) {
+        if (i > 1)
+            fputs(", ", json_file);
+        json_string(json_file, argv[i]);
+    }
+    fprintf(json_file,
+            "], \"ns\": %" PRIu64
+            ", \"elements\": %d, \"blocks\": %zu, \"bytes\": %zu, "
+            "\"allocs\": %zu}\n",
+            ns, total_elements(), ms->blocks, ms->bytes, allocs);
+}
+
+static void cmd_before(int argc, char *argv[])
+{
+#ifdef QUEUE_STATS
+    stats_before(argc, argv);
+#endif
+    mem_stats_t ms;
+    mem_stats(&ms);
+    cmd_start_allocs = ms.allocs;
+    cmd_start = time_ns();
+}
+
+static void cmd_after(int argc, char *argv[])
+{
+    uint64_t ns = time_ns() - cmd_start;
+#ifdef QUEUE_STATS
+    stats_after(argc, argv);
+#endif
+    mem_stats_t ms;
+    mem_stats(&ms);
+    size_t allocs = ms.allocs - cmd_start_allocs;
+    mem_record(argv[0], allocs, ns);
+    if (json_file)
+        json_record(argc, argv, ns, &ms, allocs);
+}
+
 static void console_init()
 {
-    ADD_COMMAND(new, "Create new queue", "");
+    ADD_COMMAND(new, "Create new queue, or priority queue in heap mode",
+                "[heap]");
     ADD_COMMAND(free, "Delete queue", "");
     ADD_COMMAND(prev, "Switch to previous queue", "");
     ADD_COMMAND(next, "Switch to next queue", "");
@@ -1046,6 +2232,8 @@ static void console_init()
         rh,
         "Remove from head of queue. Optionally compare to expected value str",
         "[str]");
+    ADD_COMMAND(rhq, "Remove from head of queue n times without reporting",
+                "[n]");
     ADD_COMMAND(
         rt,
         "Remove from tail of queue. Optionally compare to expected value str",
@@ -1058,6 +2246,7 @@ static void console_init()
     ADD_COMMAND(dedup, "Delete all nodes that have duplicate string", "");
     ADD_COMMAND(merge, "Merge all the queues into one sorted queue", "");
     ADD_COMMAND(swap, "Swap every two adjacent nodes in queue", "");
+    ADD_COMMAND(perturb, "Swap the strings of n random pairs of nodes", "n");
     ADD_COMMAND(descend,
                 "Remove every node which has a node with a strictly greater "
                 "value anywhere to the right side of it",
@@ -1065,12 +2254,99 @@ static void console_init()
     ADD_COMMAND(list_sort, "linux kernel list_sort", "");
     ADD_COMMAND(reverseK, "Reverse the nodes of the queue 'K' at a time",
                 "[K]");
+    ADD_COMMAND(isort,
+                "Insert string str n times in sorted position of an ascending "
+                "queue, using a skip list index (default: n == 1). The index "
+                "is rebuilt in O(n) after commands other than isort, ri, dm, "
+                "rank and count change the queue",
+                "str [n]");
+    ADD_COMMAND(ri,
+                "Remove the element at index idx, using a skip list index. "
+                "Optionally compare to expected value str. The index is "
+                "rebuilt in O(n) after commands other than isort, ri, dm, "
+                "rank and count change the queue",
+                "idx [str]");
+    ADD_COMMAND(rank,
+                "Count the elements less and greater than str, using an "
+                "order-statistic tree. The tree is rebuilt in O(n log n) "
+                "after commands other than isort, ri, dm and the tree "
+                "commands change the queue",
+                "str");
+    ADD_COMMAND(count,
+                "Count the elements between lo and hi inclusive, using an "
+                "order-statistic tree. The tree is rebuilt in O(n log n) "
+                "after commands other than isort, ri, dm and the tree "
+                "commands change the queue",
+                "lo hi");
+    ADD_COMMAND(rdel,
+                "Delete the elements between lo and hi inclusive, using an "
+                "order-statistic tree. The tree is rebuilt in O(n log n) "
+                "after commands other than isort, ri, dm and the tree "
+                "commands change the queue",
+                "lo hi");
+    ADD_COMMAND(mem,
+                "Show the memory of the queues, of the interpreter and of the "
+                "process, and the allocations of each command",
+                "");
+    ADD_COMMAND(mtalloc,
+                "Allocate and free n blocks in each of threads threads at "
+                "once (default: 4), each freeing those of another one",
+                "n [threads]");
+    ADD_COMMAND(complexity,
+                "Fit the time of the operation of a command, on queues of 1K "
+                "to 4M elements or max, to O(1), O(log n), O(n), O(n log n) "
+                "and O(n^2), and check the class if given (1, logn, n, nlogn "
+                "or n2)",
+                "cmd [max [class]]");
+    ADD_COMMAND(ctstate,
+                "Keep the statistics of the constant time tests in file, and "
+                "continue from them, or stop keeping them",
+                "[file]");
+    ADD_COMMAND(ctmerge,
+                "Add the statistics of constant time tests kept in files to "
+                "those of the ctstate file",
+                "file ...");
+    ADD_COMMAND(ctstream,
+                "Append the t statistics of constant time tests to file every "
+                "n measurements (default 1000), or stop",
+                "[file [n]]");
+    ADD_COMMAND(cttrace,
+                "Append every measurement of constant time tests to file, "
+                "read by cthist, or stop",
+                "[file]");
+    ADD_COMMAND(stats,
+                "Show the comparisons, node visits and pointer writes of the "
+                "queue code, or reset them",
+                "[reset]");
     add_param("length", &string_length, "Maximum length of displayed string",
               NULL);
+    add_param("randlen", &rand_length,
+              "Length of RAND strings is at least 5 and less than randlen",
+              set_rand_length);
+    add_param("memreport", &mem_on_quit, "Show the memory use on quit", NULL);
+    add_param("treecheck", &tree_check,
+              "Check rank, count and rdel against a walk of the queue every "
+              "n calls, 0 for never",
+              NULL);
+    add_param("timelimit", &time_limit,
+              "Seconds a queue operation may run, 0 for no limit", NULL);
     add_param("malloc", &fail_probability, "Malloc failure probability percent",
               NULL);
     add_param("fail", &fail_limit,
               "Number of times allow queue operations to return false", NULL);
+    add_param("generic", &list_sort_generic,
+              "Call the comparison of list_sort through a pointer", NULL);
+    add_param("sortmode", &sort_mode,
+              "Order of sort, list_sort and merge: 0 lexicographic, 1 length "
+              "then lexicographic, 2 numbers by value",
+              set_sort_mode);
+    add_param("descend", &sort_descend,
+              "Sort and merge in descending order instead of ascending",
+              NULL);
+    add_param("workers", &dudect_workers,
+              "Number of threads, each pinned to a CPU, measuring in "
+              "simulation mode",
+              set_dudect_workers);
 }
 
 /* Signal handlers */
@@ -1107,13 +2383,14 @@ static bool q_quit(int argc, char *argv[])
     if (current && current->size > BIG_LIST_SIZE)
         set_cautious_mode(false);
 
+    drop_index();
     if (exception_setup(true)) {
         struct list_head *cur = chain.head.next;
         while (chain.size > 0) {
             queue_contex_t *qctx, *tmp;
             tmp = qctx = list_entry(cur, queue_contex_t, chain);
             cur = cur->next;
-            q_free(qctx->q);
+            release_queue(qctx);
             free(tmp);
             chain.size--;
         }
@@ -1134,11 +2411,13 @@ static bool q_quit(int argc, char *argv[])
 
 static void usage(char *cmd)
 {
-    printf("Usage: %s [-h] [-f IFILE][-v VLEVEL][-l LFILE]\n", cmd);
+    printf("Usage: %s [-h] [-f IFILE][-v VLEVEL][-l LFILE][-j JFILE]\n", cmd);
     printf("\t-h         Print this information\n");
     printf("\t-f IFILE   Read commands from IFILE\n");
     printf("\t-v VLEVEL  Set verbosity level\n");
     printf("\t-l LFILE   Echo results to LFILE\n");
+    printf("\t-j JFILE   Write the time and memory use of every command to "
+           "JFILE, as JSON lines\n");
     exit(0);
 }
 
@@ -1209,7 +2488,7 @@ int main(int argc, char *argv[])
     int level = 4;
     int c;
 
-    while ((c = getopt(argc, argv, "hv:f:l:")) != -1) {
+    while ((c = getopt(argc, argv, "hv:f:l:j:")) != -1) {
         switch (c) {
         case 'h':
             usage(argv[0]);
@@ -1234,6 +2513,13 @@ int main(int argc, char *argv[])
             buf[BUFSIZE - 1] = '\0';
             logfile_name = lbuf;
             break;
+        case 'j':
+            json_file = fopen(optarg, "w");
+            if (!json_file) {
+                fprintf(stderr, "Couldn't open JSON file '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         default:
             printf("Unknown option '%c'\n", c);
             usage(argv[0]);
@@ -1266,20 +2552,19 @@ int main(int argc, char *argv[])
         set_logfile(logfile_name);
 
     add_quit_helper(q_quit);
+    set_time_elements(total_elements);
+    set_cmd_hooks(cmd_before, cmd_after);
 
     bool ok = true;
     ok = ok && run_console(infile_name);
 
+    if (mem_on_quit)
+        mem_report(1);
+
     /* Do finish_cmd() before check whether ok is true or false */
     ok = finish_cmd() && ok;
+    if (json_file)
+        fclose(json_file);
 
     return !ok;
 }
-__attribute__((nonnull(2, 3))) int cmp(void *priv,
-                                       const struct list_head *list1,
-                                       const struct list_head *list2)
-{
-    element_t *list1_entry = list_entry(list1, element_t, list);
-    element_t *list2_entry = list_entry(list2, element_t, list);
-    return strcmp(list1_entry->value, list2_entry->value) < 0 ? 0 : 1;
-}
\ No newline at end of file
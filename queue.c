@@ -1,14 +1,22 @@
 #include "queue.h"
+#include "order.h"
+#include "stats.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef QUEUE_STATS
+struct queue_stats queue_stats;
+#endif
+
 /*
  * Function prototypes
  */
-struct list_head *merge_sort(struct list_head *head);
-struct list_head *mergeTwoLists(struct list_head *L1, struct list_head *L2);
+struct list_head *run_sort(struct list_head *head, const struct order *o);
+struct list_head *mergeTwoLists(struct list_head *L1,
+                                struct list_head *L2,
+                                const struct order *o);
 
 /* Notice: sometimes, Cppcheck would find the potential NULL pointer bugs,
  * but some of them cannot occur. You can suppress them by adding the
@@ -55,7 +63,7 @@ bool q_insert_head(struct list_head *head, char *s)
     }
     strncpy(element->value, s, len);
     *(element->value + len) = '\0';
-    list_add(&element->list, head);
+    STAT_LIST_ADD(&element->list, head);
     return true;
 }
 
@@ -75,7 +83,7 @@ bool q_insert_tail(struct list_head *head, char *s)
     }
     strncpy(element->value, s, len);
     *(element->value + len) = '\0';
-    list_add_tail(&element->list, head);
+    STAT_LIST_ADD_TAIL(&element->list, head);
     return true;
 }
 
@@ -89,7 +97,7 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize)
         strncpy(sp, element->value, bufsize - 1);
         *(sp + bufsize - 1) = '\0';
     }
-    list_del_init(&element->list);
+    STAT_LIST_DEL_INIT(&element->list);
     return element;
 }
 
@@ -103,7 +111,7 @@ element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize)
         strncpy(sp, element->value, bufsize - 1);
         *(sp + bufsize - 1) = '\0';
     }
-    list_del_init(&element->list);
+    STAT_LIST_DEL_INIT(&element->list);
     return element;
 }
 
@@ -114,8 +122,10 @@ int q_size(struct list_head *head)
         return 0;
     int count = 0;
     struct list_head *temp = NULL;
-    list_for_each (temp, head)
+    list_for_each (temp, head) {
+        STAT_VISIT();
         count++;
+    }
     return count;
 }
 
@@ -134,16 +144,18 @@ bool q_delete_mid(struct list_head *head)
     while (forward != backward && forward != backward->prev) {
         forward = forward->next;
         backward = backward->prev;
+        STAT_VISIT();
+        STAT_VISIT();
     }
     if (forward == backward) {
         element_t *element = list_first_entry(forward->prev, element_t, list);
-        list_del(forward);
+        STAT_LIST_DEL(forward);
         q_release_element(element);
         return true;
     }
     if (forward == backward->prev) {
         element_t *element = list_first_entry(forward, element_t, list);
-        list_del(backward);
+        STAT_LIST_DEL(backward);
         q_release_element(element);
         return true;
     }
@@ -162,12 +174,15 @@ bool q_delete_dup(struct list_head *head)
         struct list_head *next = curr->next;
         element_t *curr_entry = list_entry(curr, element_t, list);
         element_t *next_entry = list_entry(next, element_t, list);
+        STAT_VISIT();
+        if (next != head)
+            STAT_CMP();
         if ((next != head) && (!strcmp(curr_entry->value, next_entry->value))) {
-            list_del(curr);
+            STAT_LIST_DEL(curr);
             q_release_element(curr_entry);
             diff = true;
         } else if (diff) {
-            list_del(curr);
+            STAT_LIST_DEL(curr);
             q_release_element(curr_entry);
             diff = false;
         }
@@ -189,7 +204,9 @@ void q_swap(struct list_head *head)
     right->next = left;
     right->prev = head;
     left->prev = right;
+    STAT_WRITE(6);
     while (left->next != head) {
+        STAT_VISIT();
         if (left->next->next != head) {
             right = left->next->next;
             right->prev->next = right->next;
@@ -199,6 +216,8 @@ void q_swap(struct list_head *head)
             right->prev = left;
             left->next = right;
             left = right->next;
+            STAT_VISIT();
+            STAT_WRITE(6);
         } else
             break;
     }
@@ -212,8 +231,10 @@ void q_reverse(struct list_head *head)
         return;
     struct list_head *node = NULL;
     struct list_head *safe = NULL;
-    list_for_each_safe (node, safe, head)
-        list_move(node, head);
+    list_for_each_safe (node, safe, head) {
+        STAT_LIST_MOVE(node, head);
+        STAT_VISIT();
+    }
     return;
 }
 
@@ -230,8 +251,10 @@ void q_reverseK(struct list_head *head, int k)
     else {
         int count = 0;
         struct list_head *node = NULL;
-        list_for_each (node, head)
+        list_for_each (node, head) {
+            STAT_VISIT();
             count++;
+        }
         if (count < k)
             return;
         else {
@@ -241,13 +264,17 @@ void q_reverseK(struct list_head *head, int k)
             struct list_head *sub_head = head;
             struct list_head *cut_pos = head;
             for (int i = 0; i < repeat_times; i++) {
-                for (int j = 0; j < k; j++)
+                for (int j = 0; j < k; j++) {
                     cut_pos = cut_pos->next;
-                list_cut_position(head_temp, sub_head, cut_pos);
+                    STAT_VISIT();
+                }
+                STAT_LIST_CUT_POSITION(head_temp, sub_head, cut_pos);
                 q_reverse(head_temp);
-                list_splice_init(head_temp, sub_head);
-                for (int j = 0; j < k; j++)
+                STAT_LIST_SPLICE_INIT(head_temp, sub_head);
+                for (int j = 0; j < k; j++) {
                     sub_head = sub_head->next;
+                    STAT_VISIT();
+                }
                 cut_pos = sub_head;
             }
         }
@@ -257,19 +284,29 @@ void q_reverseK(struct list_head *head, int k)
 
 /* Sort elements of queue in ascending order */
 void q_sort(struct list_head *head)
+{
+    q_sort_by(head, NULL);
+}
+
+/* Sort elements of queue in the given order */
+void q_sort_by(struct list_head *head, const struct order *o)
 {
     if (!head || list_empty(head) || list_is_singular(head))
         return;
     head->prev->next = NULL;
-    head->next = merge_sort(head->next);
+    head->next = run_sort(head->next, o);
+    STAT_WRITE(2);
     struct list_head *curr = head, *next = curr->next;
     while (next) {
         next->prev = curr;
         curr = next;
         next = next->next;
+        STAT_VISIT();
+        STAT_WRITE(1);
     }
     curr->next = head;
     head->prev = curr;
+    STAT_WRITE(2);
 }
 
 /* Remove every node which has a node with a strictly greater value anywhere to
@@ -286,10 +323,13 @@ int q_descend(struct list_head *head)
          &entry->list != head;
          entry = safe, safe = list_entry(safe->list.prev, element_t, list)) {
         total += 1;
+        STAT_VISIT();
+        if (max)
+            STAT_CMP();
         if (!max || strcmp(entry->value, max) > 0) {
             max = entry->value;
         } else {
-            list_del(&entry->list);
+            STAT_LIST_DEL(&entry->list);
             q_release_element(entry);
             n_del += 1;
         }
@@ -299,6 +339,12 @@ int q_descend(struct list_head *head)
 
 /* Merge all the queues into one sorted queue, which is in ascending order */
 int q_merge(struct list_head *head)
+{
+    return q_merge_by(head, NULL);
+}
+
+/* Merge all the queues into one queue sorted in the given order */
+int q_merge_by(struct list_head *head, const struct order *o)
 {
     // https://leetcode.com/problems/merge-k-sorted-lists/
     // reference to @chiangkd
@@ -311,284 +357,316 @@ int q_merge(struct list_head *head)
     list_for_each_entry_safe (c_cont, n_cont, head, chain) {  // iterate context
         c_cont->q->prev->next = NULL;
         c_cont->q->prev = NULL;
-        sorted = mergeTwoLists(sorted, c_cont->q->next);
-        INIT_LIST_HEAD(c_cont->q);  // reconnect the lists which are moved and
-                                    // merged to "sorted" list;
+        STAT_WRITE(2);
+        sorted = mergeTwoLists(sorted, c_cont->q->next, o);
+        STAT_INIT_LIST_HEAD(c_cont->q);  // reconnect the lists which are moved
+                                         // and merged to "sorted" list;
     }
     LIST_HEAD(tmp);
     struct list_head *t = &tmp;
     t->next = sorted;
+    STAT_WRITE(1);
     struct list_head *c = t;
     while (sorted) {
         sorted->prev = c;
         c = sorted;
         sorted = sorted->next;
+        STAT_VISIT();
+        STAT_WRITE(1);
     }
     c->next = t;
     t->prev = c;
+    STAT_WRITE(2);
     int size = q_size(t);  // store size before splice to main queue
-    list_splice(t, list_first_entry(head, queue_contex_t, chain)->q);
+    STAT_LIST_SPLICE(t, list_first_entry(head, queue_contex_t, chain)->q);
     return size;
 }
 
-struct list_head *merge_sort(struct list_head *head)
-{
-    if (!head || !head->next)
-        return head;
-    struct list_head *slow = head;
-    for (struct list_head *fast = head->next; fast && fast->next;
-         fast = fast->next->next) {
-        slow = slow->next;
-    }
-    struct list_head *mid = slow->next;
-    slow->next = NULL;
-    struct list_head *left = merge_sort(head), *right = merge_sort(mid);
-    return mergeTwoLists(left, right);
-}
-
 /*
  * Merge two sublists to one sorted list
  */
-struct list_head *mergeTwoLists(struct list_head *L1, struct list_head *L2)
+struct list_head *mergeTwoLists(struct list_head *L1,
+                                struct list_head *L2,
+                                const struct order *o)
 {
     struct list_head *head = NULL, **ptr = &head, **node = NULL;
     while (L1 && L2) {
         element_t *L1_entry = list_entry(L1, element_t, list);
         element_t *L2_entry = list_entry(L2, element_t, list);
-        node = strcmp(L1_entry->value, L2_entry->value) < 0 ? &L1 : &L2;
+        node = order_cmp(o, L1_entry->value, L2_entry->value) <= 0 ? &L1 : &L2;
         *ptr = *node;
         ptr = &(*ptr)->next;
         *node = (*node)->next;
+        STAT_CMP();
+        STAT_VISIT();
+        STAT_WRITE(1);
     }
     *ptr = (struct list_head *) ((uintptr_t) L1 | (uintptr_t) L2);
+    STAT_WRITE(1);
     return head;
 }
 
-static struct list_head *merge(struct list_head *a, struct list_head *b)
+/*
+ * Run-adaptive merge sort, in the spirit of TimSort.  The list is cut into
+ * its natural runs: non-descending ones are kept as they are, and strictly
+ * descending ones are reversed in place, which keeps the sort stable.  Runs
+ * are pushed on a stack and merged as soon as their lengths break the TimSort
+ * invariants, so that merges stay balanced.  A sorted or reverse-sorted list
+ * is a single run and sorts in linear time.  Runs shorter than MIN_RUN are
+ * extended to it by binary insertion, as merging many short runs costs more
+ * than sorting small blocks of nodes in place.
+ */
+
+/* Shortest run, but the last one */
+#define MIN_RUN 32
+
+/* A merge switches to galloping after this many consecutive wins of a run */
+#define MIN_GALLOP 7
+
+/* Run lengths on the stack grow at least as fast as the Fibonacci numbers */
+#define MAX_RUNS 85
+
+struct run {
+    struct list_head *head, *tail;
+    size_t len;
+};
+
+static inline int value_cmp(const struct order *o,
+                            const struct list_head *a,
+                            const struct list_head *b)
 {
-    struct list_head *head = NULL, **tail = &head;
+    STAT_CMP();
+    return order_cmp(o, list_entry(a, element_t, list)->value,
+                     list_entry(b, element_t, list)->value);
+}
 
-    for (;;) {
-        /* if equal, take 'a' -- important for sort stability */
-        if (strcmp(container_of(a, element_t, list)->value,
-                   container_of(b, element_t, list)->value) <= 0) {
-            *tail = a;
-            tail = &a->next;
-            a = a->next;
-            if (!a) {
-                *tail = b;
-                break;
-            }
-        } else {
-            *tail = b;
-            tail = &b->next;
-            b = b->next;
-            if (!b) {
-                *tail = a;
-                break;
-            }
-        }
+/* Detach the natural run starting at node into r, and return the rest of
+ * the list
+ */
+static struct list_head *natural_run(struct list_head *node,
+                                     struct run *r,
+                                     const struct order *o)
+{
+    struct list_head *next = node->next;
+    r->len = 1;
+    r->head = r->tail = node;
+    if (!next)
+        return NULL;
+
+    if (value_cmp(o, node, next) > 0) {
+        struct list_head *prev = node;
+        node->next = NULL;
+        STAT_WRITE(1);
+        do {
+            struct list_head *tmp = next->next;
+            next->next = prev;
+            prev = next;
+            next = tmp;
+            r->len++;
+            STAT_VISIT();
+            STAT_WRITE(1);
+        } while (next && value_cmp(o, prev, next) > 0);
+        r->head = prev;
+        return next;
     }
-    return head;
+
+    struct list_head *tail = next;
+    r->len = 2;
+    while (tail->next && value_cmp(o, tail, tail->next) <= 0) {
+        tail = tail->next;
+        r->len++;
+        STAT_VISIT();
+    }
+    r->tail = tail;
+    next = tail->next;
+    tail->next = NULL;
+    STAT_VISIT();
+    STAT_WRITE(1);
+    return next;
 }
 
-/*
- * Combine final list merge with restoration of standard doubly-linked
- * list structure.  This approach duplicates code from merge(), but
- * runs faster than the tidier alternatives of either a separate final
- * prev-link restoration pass, or maintaining the prev links
- * throughout.
+/* Detach the run starting at node into r, extended to MIN_RUN nodes by
+ * binary insertion if it is shorter, and return the rest of the list
  */
+static struct list_head *find_run(struct list_head *node,
+                                  struct run *r,
+                                  const struct order *o)
+{
+    struct list_head *next = natural_run(node, r, o);
+    if (!next || r->len >= MIN_RUN)
+        return next;
+
+    /* Sort the nodes in an array, where bisecting is cheap */
+    struct list_head *a[MIN_RUN];
+    size_t len = 0;
+    for (struct list_head *x = r->head; x; x = x->next) {
+        a[len++] = x;
+        STAT_VISIT();
+    }
+    while (next && len < MIN_RUN) {
+        /* Past the nodes not greater than next, for stability */
+        size_t lo = 0, hi = len;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (value_cmp(o, a[mid], next) <= 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        memmove(&a[lo + 1], &a[lo], (len - lo) * sizeof(a[0]));
+        a[lo] = next;
+        len++;
+        next = next->next;
+        STAT_VISIT();
+    }
+
+    for (size_t i = 0; i + 1 < len; i++)
+        a[i]->next = a[i + 1];
+    a[len - 1]->next = NULL;
+    STAT_WRITE(len);
+    r->head = a[0];
+    r->tail = a[len - 1];
+    r->len = len;
+    return next;
+}
+
+/* Does node go before pivot?  Ties go to the left run for stability. */
+static inline bool wins(const struct list_head *node,
+                        const struct list_head *pivot,
+                        bool left,
+                        const struct order *o)
+{
+    int c = value_cmp(o, node, pivot);
+    return left ? c <= 0 : c < 0;
+}
 
-static void merge_final(struct list_head *head,
-                        struct list_head *a,
-                        struct list_head *b)
+/* Advance up to n nodes, stopping at the last one of the list */
+static struct list_head *walk(struct list_head *node, size_t n, size_t *moved)
 {
-    struct list_head *tail = head;
+    *moved = 0;
+    while (*moved < n && node->next) {
+        node = node->next;
+        (*moved)++;
+        STAT_VISIT();
+    }
+    return node;
+}
 
+/* Find the last node of the block starting at x that goes before pivot, where
+ * x itself is known to.  Probing at exponentially growing distances, then
+ * bisecting the last gap, takes O(log k) comparisons for a block of k nodes.
+ */
+static struct list_head *gallop(struct list_head *x,
+                                const struct list_head *pivot,
+                                bool left,
+                                const struct order *o)
+{
+    size_t step = 1, gap = 0;
     for (;;) {
-        /* if equal, take 'a' -- important for sort stability */
-        if (strcmp(container_of(a, element_t, list)->value,
-                   container_of(b, element_t, list)->value) <= 0) {
-            tail->next = a;
-            a->prev = tail;
-            tail = a;
-            a = a->next;
-            if (!a)
-                break;
+        size_t moved;
+        struct list_head *probe = walk(x, step, &moved);
+        if (!moved)
+            return x;
+        if (!wins(probe, pivot, left, o)) {
+            gap = moved;
+            break;
+        }
+        x = probe;
+        step <<= 1;
+    }
+    while (gap > 1) {
+        size_t half = gap / 2, moved;
+        struct list_head *mid = walk(x, half, &moved);
+        if (wins(mid, pivot, left, o)) {
+            x = mid;
+            gap -= half;
         } else {
-            tail->next = b;
-            b->prev = tail;
-            tail = b;
-            b = b->next;
-            if (!b) {
-                b = a;
-                break;
-            }
+            gap = half;
         }
     }
-
-    /* Finish linking remainder of list b on to tail */
-    tail->next = b;
-    do {
-        /*
-         * If the merge is highly unbalanced (e.g. the input is
-         * already sorted), this loop may run many iterations.
-         * Continue callbacks to the client even though no
-         * element comparison is needed, so the client's cmp()
-         * routine can invoke cond_resched() periodically.
-         */
-
-        b->prev = tail;
-        tail = b;
-        b = b->next;
-    } while (b);
-
-    /* And the final links to make a circular doubly-linked list */
-    tail->next = head;
-    head->prev = tail;
+    return x;
 }
 
-/**
- * list_sort - sort a list
- * @priv: private data, opaque to list_sort(), passed to @cmp
- * @head: the list to sort
- * @cmp: the elements comparison function
- *
- * The comparison function @cmp must return > 0 if @a should sort after
- * @b ("@a > @b" if you want an ascending sort), and <= 0 if @a should
- * sort before @b *or* their original order should be preserved.  It is
- * always called with the element that came first in the input in @a,
- * and list_sort is a stable sort, so it is not necessary to distinguish
- * the @a < @b and @a == @b cases.
- *
- * This is compatible with two styles of @cmp function:
- * - The traditional style which returns <0 / =0 / >0, or
- * - Returning a boolean 0/1.
- * The latter offers a chance to save a few cycles in the comparison
- * (which is used by e.g. plug_ctx_cmp() in block/blk-mq.c).
- *
- * A good way to write a multi-word comparison is::
- *
- *	if (a->high != b->high)
- *		return a->high > b->high;
- *	if (a->middle != b->middle)
- *		return a->middle > b->middle;
- *	return a->low > b->low;
- *
- *
- * This mergesort is as eager as possible while always performing at least
- * 2:1 balanced merges.  Given two pending sublists of size 2^k, they are
- * merged to a size-2^(k+1) list as soon as we have 2^k following elements.
- *
- * Thus, it will avoid cache thrashing as long as 3*2^k elements can
- * fit into the cache.  Not quite as good as a fully-eager bottom-up
- * mergesort, but it does use 0.2*n fewer comparisons, so is faster in
- * the common case that everything fits into L1.
- *
- *
- * The merging is controlled by "count", the number of elements in the
- * pending lists.  This is beautifully simple code, but rather subtle.
- *
- * Each time we increment "count", we set one bit (bit k) and clear
- * bits k-1 .. 0.  Each time this happens (except the very first time
- * for each bit, when count increments to 2^k), we merge two lists of
- * size 2^k into one list of size 2^(k+1).
- *
- * This merge happens exactly when the count reaches an odd multiple of
- * 2^k, which is when we have 2^k elements pending in smaller lists,
- * so it's safe to merge away two lists of size 2^k.
- *
- * After this happens twice, we have created two lists of size 2^(k+1),
- * which will be merged into a list of size 2^(k+2) before we create
- * a third list of size 2^(k+1), so there are never more than two pending.
- *
- * The number of pending lists of size 2^k is determined by the
- * state of bit k of "count" plus two extra pieces of information:
- *
- * - The state of bit k-1 (when k == 0, consider bit -1 always set), and
- * - Whether the higher-order bits are zero or non-zero (i.e.
- *   is count >= 2^(k+1)).
- *
- * There are six states we distinguish.  "x" represents some arbitrary
- * bits, and "y" represents some arbitrary non-zero bits:
- * 0:  00x: 0 pending of size 2^k;           x pending of sizes < 2^k
- * 1:  01x: 0 pending of size 2^k; 2^(k-1) + x pending of sizes < 2^k
- * 2: x10x: 0 pending of size 2^k; 2^k     + x pending of sizes < 2^k
- * 3: x11x: 1 pending of size 2^k; 2^(k-1) + x pending of sizes < 2^k
- * 4: y00x: 1 pending of size 2^k; 2^k     + x pending of sizes < 2^k
- * 5: y01x: 2 pending of size 2^k; 2^(k-1) + x pending of sizes < 2^k
- * (merge and loop back to state 2)
- *
- * We gain lists of size 2^k in the 2->3 and 4->5 transitions (because
- * bit k-1 is set while the more significant bits are non-zero) and
- * merge them away in the 5->2 transition.  Note in particular that just
- * before the 5->2 transition, all lower-order bits are 11 (state 3),
- * so there is one list of each smaller size.
- *
- * When we reach the end of the input, we merge all the pending
- * lists, from smallest to largest.  If you work through cases 2 to
- * 5 above, you can see that the number of elements we merge with a list
- * of size 2^k varies from 2^(k-1) (cases 3 and 5 when x == 0) to
- * 2^(k+1) - 1 (second merge of case 5 when x == 2^(k-1) - 1).
- */
-
-void list_sort(struct list_head *head)
+/* Merge run b, which follows run a in the input, into a */
+static void merge_runs(struct run *a, struct run *b, const struct order *o)
 {
-    struct list_head *list = head->next, *pending = NULL;
-    size_t count = 0; /* Count of pending */
-
-    if (list == head->prev) /* Zero or one elements */
+    a->len += b->len;
+    if (value_cmp(o, a->tail, b->head) <= 0) {
+        a->tail->next = b->head;
+        a->tail = b->tail;
+        STAT_WRITE(1);
         return;
+    }
+    if (value_cmp(o, b->tail, a->head) < 0) {
+        b->tail->next = a->head;
+        a->head = b->head;
+        STAT_WRITE(1);
+        return;
+    }
 
-    /* Convert to a null-terminated singly-linked list. */
-    head->prev->next = NULL;
-
-    /*
-     * Data structure invariants:
-     * - All lists are singly linked and null-terminated; prev
-     *   pointers are not maintained.
-     * - pending is a prev-linked "list of lists" of sorted
-     *   sublists awaiting further merging.
-     * - Each of the sorted sublists is power-of-two in size.
-     * - Sublists are sorted by size and age, smallest & newest at front.
-     * - There are zero to two sublists of each size.
-     * - A pair of pending sublists are merged as soon as the number
-     *   of following pending elements equals their size (i.e.
-     *   each time count reaches an odd multiple of that size).
-     *   That ensures each later final merge will be at worst 2:1.
-     * - Each round consists of:
-     *   - Merging the two sublists selected by the highest bit
-     *     which flips when count is incremented, and
-     *   - Adding an element from the input as a size-1 sublist.
-     */
-    do {
-        size_t bits;
-        struct list_head **tail = &pending;
-
-        /* Find the least-significant clear bit in count */
-        for (bits = count; bits & 1; bits >>= 1)
-            tail = &(*tail)->prev;
-
-        /* Move one element from input list to pending */
-        list->prev = pending;
-        pending = list;
-        list = list->next;
-        pending->next = NULL;
-        count++;
-    } while (list);
+    struct list_head *l = a->head, *r = b->head;
+    struct list_head *head = NULL, **ptr = &head;
+    int l_wins = 0, r_wins = 0;
+    while (l && r) {
+        struct list_head **node, *last;
+        if (value_cmp(o, l, r) <= 0) {
+            node = &l;
+            last = ++l_wins >= MIN_GALLOP ? gallop(l, r, true, o) : l;
+            r_wins = 0;
+        } else {
+            node = &r;
+            last = ++r_wins >= MIN_GALLOP ? gallop(r, l, false, o) : r;
+            l_wins = 0;
+        }
+        *ptr = *node;
+        ptr = &last->next;
+        *node = last->next;
+        STAT_VISIT();
+        STAT_WRITE(1);
+    }
+    *ptr = l ? l : r;
+    STAT_WRITE(1);
+    a->head = head;
+    if (!l)
+        a->tail = b->tail;
+}
 
-    /* End of input; merge together all the pending lists. */
-    list = pending;
-    pending = pending->prev;
-    for (;;) {
-        struct list_head *next = pending->prev;
+/* Merge the runs at i and i + 1 on the stack */
+static void merge_at(struct run *stack, int *n, int i, const struct order *o)
+{
+    merge_runs(&stack[i], &stack[i + 1], o);
+    for (int j = i + 1; j < *n - 1; j++)
+        stack[j] = stack[j + 1];
+    (*n)--;
+}
 
-        if (!next)
+/* Restore the TimSort invariants on the stack of pending runs */
+static void collapse(struct run *stack, int *n, const struct order *o)
+{
+    while (*n > 1) {
+        int i = *n - 2;
+        if ((i > 0 && stack[i - 1].len <= stack[i].len + stack[i + 1].len) ||
+            (i > 1 &&
+             stack[i - 2].len <= stack[i - 1].len + stack[i].len)) {
+            if (stack[i - 1].len < stack[i + 1].len)
+                i--;
+        } else if (stack[i].len > stack[i + 1].len) {
             break;
-        list = merge(pending, list);
-        pending = next;
+        }
+        merge_at(stack, n, i, o);
+    }
+}
+
+/* Sort a NULL-terminated list linked through next */
+struct list_head *run_sort(struct list_head *head, const struct order *o)
+{
+    struct run stack[MAX_RUNS];
+    int n = 0;
+    while (head) {
+        head = find_run(head, &stack[n++], o);
+        collapse(stack, &n, o);
     }
-    /* The final merge, rebuilding prev links */
-    merge_final(head, pending, list);
+    while (n > 1)
+        merge_at(stack, &n, n - 2, o);
+    return n ? stack[0].head : NULL;
 }
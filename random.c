@@ -28,6 +28,10 @@
 #define _GNU_SOURCE
 #endif
 
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
 #include "random.h"
 
 #if defined(__linux__) || defined(__GNU__)
@@ -293,3 +297,211 @@ int randombytes(uint8_t *buf, size_t n)
 #error "randombytes(...) is not supported on this platform"
 #endif
 }
+
+/* xoshiro256** by David Blackman and Sebastiano Vigna, see
+ * <https://prng.di.unimi.it/xoshiro256starstar.c>
+ */
+static __thread uint64_t xoshiro[4];
+static __thread bool xoshiro_seeded;
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* splitmix64, by Sebastiano Vigna, to expand a seed into a state */
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* The state must not be all zeros, which xoshiro would never leave */
+static void xoshiro_seed(void)
+{
+    if (randombytes((uint8_t *) xoshiro, sizeof(xoshiro)) ||
+        !(xoshiro[0] | xoshiro[1] | xoshiro[2] | xoshiro[3])) {
+        uint64_t x = (uintptr_t) xoshiro ^ (uint64_t) time(NULL);
+        for (int i = 0; i < 4; i++)
+            xoshiro[i] = splitmix64(&x);
+    }
+    xoshiro_seeded = true;
+}
+
+static inline uint64_t xoshiro_next(uint64_t *s)
+{
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+/* n numbers at once, with the state kept in registers meanwhile */
+static void random_words(uint64_t *w, size_t n)
+{
+    if (!xoshiro_seeded)
+        xoshiro_seed();
+
+    uint64_t s[4] = {xoshiro[0], xoshiro[1], xoshiro[2], xoshiro[3]};
+    for (size_t i = 0; i < n; i++)
+        w[i] = xoshiro_next(s);
+    memcpy(xoshiro, s, sizeof(s));
+}
+
+uint64_t random_next(void)
+{
+    if (!xoshiro_seeded)
+        xoshiro_seed();
+    return xoshiro_next(xoshiro);
+}
+
+/* Numbers drawn at once by the bulk functions */
+#define WORDS 64
+
+void random_fill(uint8_t *buf, size_t len)
+{
+    uint64_t w[WORDS];
+    while (len) {
+        size_t n = len < sizeof(w) ? len : sizeof(w);
+        random_words(w, (n + sizeof(w[0]) - 1) / sizeof(w[0]));
+        memcpy(buf, w, n);
+        buf += n;
+        len -= n;
+    }
+}
+
+/* A letter is taken from 16 random bits x as x * 26 / 2^16, by Lemire's
+ * method: the product is uniform over the letters once the x whose low 16
+ * bits of the product fall below 2^16 % 26 are redrawn, about 1 in 4096.
+ * The vector versions map 16 or 32 letters at a time, and redraw all of
+ * them with the scalar version should any one be rejected.
+ */
+#define LETTERS 26
+#define LETTERS_REJECT ((1 << 16) % LETTERS)
+
+static void lowercase_scalar(char *buf, size_t len)
+{
+    uint64_t bits = 0;
+    int left = 0;
+    for (size_t i = 0; i < len;) {
+        if (!left) {
+            bits = random_next();
+            left = 4;
+        }
+        uint32_t m = (uint32_t) (uint16_t) bits * LETTERS;
+        bits >>= 16;
+        left--;
+        if ((uint16_t) m >= LETTERS_REJECT)
+            buf[i++] = 'a' + (m >> 16);
+    }
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/* Letters of the 16-bit lanes of x and y, or whether one is rejected.  The
+ * low product is compared as signed, once offset by 0x8000.
+ */
+static inline bool lowercase_sse2_map(__m128i x, __m128i y, __m128i *letters)
+{
+    const __m128i n = _mm_set1_epi16(LETTERS);
+    const __m128i offset = _mm_set1_epi16((short) 0x8000);
+    const __m128i reject = _mm_set1_epi16((short) (0x8000 + LETTERS_REJECT));
+
+    __m128i lx = _mm_xor_si128(_mm_mullo_epi16(x, n), offset);
+    __m128i ly = _mm_xor_si128(_mm_mullo_epi16(y, n), offset);
+    __m128i rejected = _mm_or_si128(_mm_cmplt_epi16(lx, reject),
+                                    _mm_cmplt_epi16(ly, reject));
+    if (_mm_movemask_epi8(rejected))
+        return false;
+
+    /* The high products are letters below 26, which packing keeps */
+    __m128i hx = _mm_mulhi_epu16(x, n), hy = _mm_mulhi_epu16(y, n);
+    *letters = _mm_add_epi8(_mm_packus_epi16(hx, hy), _mm_set1_epi8('a'));
+    return true;
+}
+
+/* 16 letters from every 4 numbers */
+static void lowercase_sse2(char *buf, size_t len)
+{
+    uint64_t w[WORDS];
+    while (len >= 16) {
+        size_t n = len / 16 < WORDS / 4 ? len / 16 : WORDS / 4;
+        random_words(w, n * 4);
+        for (size_t i = 0; i < n; i++, len -= 16, buf += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *) &w[i * 4]);
+            __m128i y = _mm_loadu_si128((const __m128i *) &w[i * 4 + 2]);
+            __m128i letters;
+            if (lowercase_sse2_map(x, y, &letters))
+                _mm_storeu_si128((__m128i *) buf, letters);
+            else
+                lowercase_scalar(buf, 16);
+        }
+    }
+    lowercase_scalar(buf, len);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+/* 32 letters from every 8 numbers.  Packing works within each 128-bit
+ * half, which leaves the letters out of the order of their bits, of no
+ * matter for random ones.
+ */
+__attribute__((target("avx2"))) static void lowercase_avx2(char *buf,
+                                                           size_t len)
+{
+    const __m256i n16 = _mm256_set1_epi16(LETTERS);
+    const __m256i offset = _mm256_set1_epi16((short) 0x8000);
+    const __m256i reject =
+        _mm256_set1_epi16((short) (0x8000 + LETTERS_REJECT));
+
+    uint64_t w[WORDS];
+    while (len >= 32) {
+        size_t n = len / 32 < WORDS / 8 ? len / 32 : WORDS / 8;
+        random_words(w, n * 8);
+        for (size_t i = 0; i < n; i++, len -= 32, buf += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i *) &w[i * 8]);
+            __m256i y = _mm256_loadu_si256((const __m256i *) &w[i * 8 + 4]);
+            __m256i lx = _mm256_xor_si256(_mm256_mullo_epi16(x, n16), offset);
+            __m256i ly = _mm256_xor_si256(_mm256_mullo_epi16(y, n16), offset);
+            __m256i rejected =
+                _mm256_or_si256(_mm256_cmpgt_epi16(reject, lx),
+                                _mm256_cmpgt_epi16(reject, ly));
+            if (_mm256_movemask_epi8(rejected)) {
+                lowercase_scalar(buf, 32);
+                continue;
+            }
+            __m256i hx = _mm256_mulhi_epu16(x, n16);
+            __m256i hy = _mm256_mulhi_epu16(y, n16);
+            __m256i letters = _mm256_add_epi8(_mm256_packus_epi16(hx, hy),
+                                              _mm256_set1_epi8('a'));
+            _mm256_storeu_si256((__m256i *) buf, letters);
+        }
+    }
+    lowercase_sse2(buf, len);
+}
+#endif
+
+void random_lowercase(char *buf, size_t len)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        lowercase_avx2(buf, len);
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    lowercase_sse2(buf, len);
+#else
+    lowercase_scalar(buf, len);
+#endif
+}
@@ -4,13 +4,25 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/* Bytes from the operating system, a system call for every request */
 extern int randombytes(uint8_t *buf, size_t len);
 
+/* Bytes from xoshiro256**, a generator in user space whose state each
+ * thread seeds from randombytes() once, for the many bytes of the tests.  It
+ * is fast and passes the statistical tests, but is not cryptographically
+ * secure: its output tells the following one.
+ */
+uint64_t random_next(void);
+void random_fill(uint8_t *buf, size_t len);
+
+/* Random lowercase letters from the same generator, len of them, without
+ * any bias and without a terminating null byte
+ */
+void random_lowercase(char *buf, size_t len);
+
 static inline uint8_t randombit(void)
 {
-    uint8_t ret = 0;
-    randombytes(&ret, 1);
-    return ret & 1;
+    return random_next() & 1;
 }
 
 #if INTPTR_MAX == INT64_MAX
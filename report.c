@@ -196,6 +196,13 @@ static size_t peak_bytes = 0;
 static size_t last_peak_bytes = 0;
 static size_t current_bytes = 0;
 
+void alloc_usage(size_t *current, size_t *peak, size_t *count)
+{
+    *current = current_bytes;
+    *peak = peak_bytes;
+    *count = allocate_cnt;
+}
+
 static void check_exceed(size_t new_bytes)
 {
     size_t limit_bytes = (size_t) mblimit << 20;
@@ -303,11 +310,16 @@ void init_time(double *timep)
     (void) delta_time(timep);
 }
 
+uint64_t time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 double delta_time(double *timep)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    double current_time = tv.tv_sec + 1.0E-6 * tv.tv_usec;
+    double current_time = 1.0E-9 * time_ns();
     double delta = current_time - *timep;
     *timep = current_time;
     return delta;
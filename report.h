@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Ways to report interesting behavior and errors */
 
@@ -44,7 +45,15 @@ void free_array(void *b, size_t cnt, size_t bytes);
 /* Free string saved by strsave_or_fail */
 void free_string(char *s);
 
-/* Time counted as fp number in seconds */
+/* Bytes currently and at most allocated by the functions above, and number
+ * of allocations they made
+ */
+void alloc_usage(size_t *current, size_t *peak, size_t *count);
+
+/* Time of the monotonic clock in nanoseconds */
+uint64_t time_ns();
+
+/* Time counted as fp number in seconds, from the monotonic clock */
 void init_time(double *timep);
 
 /* Compute time since last call with this timer and reset timer */
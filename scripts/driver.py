@@ -4,6 +4,10 @@ from __future__ import print_function
 import subprocess
 import sys
 import getopt
+import json
+import os
+import shutil
+import tempfile
 
 
 
@@ -60,6 +64,64 @@ class Tracer:
 
     maxScores = [0, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 5]
 
+    # Performance tier, run with --perf instead of the traces above.  Every
+    # command has to finish within its time budget, 1 second unless the trace
+    # raises it with option timelimit.
+    perfDict = {
+        1: "perf-01-heap",
+        2: "perf-02-sorted",
+        3: "perf-03-reversed",
+        4: "perf-04-noise",
+        5: "perf-05-list-sort",
+        6: "perf-06-huge",
+        7: "perf-07-long-strings",
+        8: "perf-08-merge",
+        9: "perf-09-adversarial-sort",
+        10: "perf-10-reverse-k"
+    }
+
+    perfScores = [0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1]
+
+    # Feature tier, run with --features instead of the traces above.  It
+    # tests the commands beyond the queue interface, and is not graded.
+    featureDict = {
+        1: "feature-01-index",
+        2: "feature-02-tree",
+        3: "feature-03-heap",
+        4: "feature-04-list-sort",
+        5: "feature-05-order",
+        6: "feature-06-threads",
+        7: "feature-07-complexity",
+        8: "feature-08-workers",
+        9: "feature-09-ctstate",
+        10: "feature-10-cttrace"
+    }
+
+    featureScores = [0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1]
+
+    # Feature traces needing more than one CPU, skipped on fewer
+    featureCpus = {8: 2}
+
+    # Commands checking the files written by feature traces, run after them
+    featureChecks = {
+        10: ["./cthist", "-c", "5000", "/tmp/qtest-scratch/rh.trace"]
+    }
+
+    # Commands checking the files each trace writes
+    traceChecks = {}
+
+    # CPUs each trace needs, none of the graded or performance ones
+    traceCpus = {}
+
+    # Directory the feature traces write their files to, emptied before each
+    # of them so that the files start afresh
+    scratchDir = "/tmp/qtest-scratch"
+    scratch = False
+
+    # Traces running faster than this in the baseline are too noisy to
+    # flag as regressions
+    minBaselineNs = 1000000
+
     RED = '\033[91m'
     GREEN = '\033[92m'
     WHITE = '\033[0m'
@@ -69,13 +131,34 @@ class Tracer:
                  verbLevel=0,
                  autograde=False,
                  useValgrind=False,
-                 colored=False):
+                 colored=False,
+                 reportFile="",
+                 baselineFile="",
+                 threshold=25,
+                 perf=False,
+                 features=False):
         if qtest != "":
             self.qtest = qtest
         self.verbLevel = verbLevel
         self.autograde = autograde
         self.useValgrind = useValgrind
         self.colored = colored
+        self.reportFile = reportFile
+        self.baselineFile = baselineFile
+        self.threshold = threshold
+        self.measure = reportFile != "" or baselineFile != ""
+        self.results = {}
+        if perf:
+            self.traceDict = self.perfDict
+            self.traceProbs = {k: "Perf-%02d" % k for k in self.perfDict}
+            self.maxScores = self.perfScores
+        elif features:
+            self.traceDict = self.featureDict
+            self.traceProbs = {k: "Feature-%02d" % k for k in self.featureDict}
+            self.maxScores = self.featureScores
+            self.traceCpus = self.featureCpus
+            self.traceChecks = self.featureChecks
+            self.scratch = True
 
     def printInColor(self, text, color):
         if self.colored == False:
@@ -89,14 +172,80 @@ class Tracer:
         fname = "%s/%s.cmd" % (self.traceDirectory, self.traceDict[tid])
         vname = "%d" % self.verbLevel
         clist = self.command + ["-v", vname, "-f", fname]
+        if self.scratch:
+            shutil.rmtree(self.scratchDir, ignore_errors=True)
+            os.makedirs(self.scratchDir)
+        if self.measure:
+            fd, jname = tempfile.mkstemp(prefix="qtest-", suffix=".json")
+            os.close(fd)
+            clist += ["-j", jname]
 
         try:
             retcode = subprocess.call(clist)
+            if retcode == 0 and tid in self.traceChecks:
+                retcode = subprocess.call(self.traceChecks[tid])
         except Exception as e:
             self.printInColor("Call of '%s' failed: %s" % (" ".join(clist), e), self.RED)
             return False
+        finally:
+            if self.scratch:
+                shutil.rmtree(self.scratchDir, ignore_errors=True)
+            if self.measure:
+                self.results[self.traceDict[tid]] = self.summarize(jname)
+                os.remove(jname)
         return retcode == 0
 
+    # Aggregate the JSON lines qtest wrote for a trace
+    def summarize(self, jname):
+        summary = {"ns": 0, "peak_elements": 0, "peak_blocks": 0,
+                   "peak_bytes": 0, "allocs": 0, "commands": {}}
+        with open(jname) as f:
+            for line in f:
+                try:
+                    rec = json.loads(line)
+                except ValueError:
+                    # The last line is cut short if qtest crashed
+                    continue
+                summary["ns"] += rec["ns"]
+                summary["peak_elements"] = max(summary["peak_elements"],
+                                               rec["elements"])
+                summary["peak_blocks"] = max(summary["peak_blocks"],
+                                             rec["blocks"])
+                summary["peak_bytes"] = max(summary["peak_bytes"],
+                                            rec["bytes"])
+                summary["allocs"] += rec["allocs"]
+                cmd = summary["commands"].setdefault(
+                    rec["cmd"], {"count": 0, "ns": 0, "max_ns": 0,
+                                 "allocs": 0})
+                cmd["count"] += 1
+                cmd["ns"] += rec["ns"]
+                cmd["allocs"] += rec["allocs"]
+                cmd["max_ns"] = max(cmd["max_ns"], rec["ns"])
+        return summary
+
+    # Compare the times of the traces with the baseline, and return the
+    # number of regressions
+    def compare(self, baseline):
+        regressions = 0
+        for tname, cur in self.results.items():
+            if tname not in baseline:
+                continue
+            base = baseline[tname]["ns"]
+            if base < self.minBaselineNs:
+                continue
+            change = 100.0 * (cur["ns"] - base) / base
+            text = "---\t%s\t%+.1f%% (%.3f ms, baseline %.3f ms)" % \
+                (tname, change, cur["ns"] / 1e6, base / 1e6)
+            if change > self.threshold:
+                regressions += 1
+                self.printInColor(text, self.RED)
+            elif self.verbLevel > 0:
+                self.printInColor(text, self.GREEN)
+        if regressions:
+            self.printInColor("---\tREGRESSIONS\t%d (threshold %d%%)" %
+                              (regressions, self.threshold), self.RED)
+        return regressions
+
     def run(self, tid=0):
         scoreDict = {k: 0 for k in self.traceDict.keys()}
         print("---\tTrace\t\tPoints")
@@ -113,8 +262,16 @@ class Tracer:
             self.command = ['valgrind', self.qtest]
         else:
             self.command = [self.qtest]
+        if hasattr(os, "sched_getaffinity"):
+            cpus = len(os.sched_getaffinity(0))
+        else:
+            cpus = os.cpu_count() or 1
         for t in tidList:
             tname = self.traceDict[t]
+            if self.traceCpus.get(t, 1) > cpus:
+                print("---\t%s\tskipped, needs %d CPUs" %
+                      (tname, self.traceCpus[t]))
+                continue
             if self.verbLevel > 0:
                 print("+++ TESTING trace %s:" % tname)
             ok = self.runTrace(t)
@@ -142,16 +299,31 @@ class Tracer:
                 jstring += '"%s" : %d' % (self.traceProbs[k], scoreDict[k])
             jstring += '}}'
             print(jstring)
-        if score < maxscore:
+        regressions = 0
+        if self.reportFile != "":
+            with open(self.reportFile, "w") as f:
+                json.dump({"traces": self.results}, f, indent=2, sort_keys=True)
+                f.write("\n")
+        if self.baselineFile != "":
+            with open(self.baselineFile) as f:
+                regressions = self.compare(json.load(f)["traces"])
+        if score < maxscore or regressions:
             sys.exit(1)
 
 def usage(name):
     print("Usage: %s [-h] [-p PROG] [-t TID] [-v VLEVEL] [--valgrind] [-c]" % name)
+    print("       [--perf | --features] [--report FILE] [--baseline FILE]")
+    print("       [--threshold PCT]")
     print("  -h        Print this message")
     print("  -p PROG   Program to test")
     print("  -t TID    Trace ID to test")
     print("  -v VLEVEL Set verbosity level (0-3)")
     print("  -c Enable colored text")
+    print("  --perf           Run the performance traces, within their time budgets")
+    print("  --features       Run the ungraded traces of the other commands")
+    print("  --report FILE    Write the time and memory use of the traces to FILE")
+    print("  --baseline FILE  Fail when a trace is slower than in FILE, a former report")
+    print("  --threshold PCT  Tolerate traces up to PCT% slower (default: 25)")
     sys.exit(0)
 
 
@@ -163,8 +335,15 @@ def run(name, args):
     autograde = False
     useValgrind = False
     colored = False
+    reportFile = ""
+    baselineFile = ""
+    threshold = 25
+    perf = False
+    features = False
 
-    optlist, args = getopt.getopt(args, 'hp:t:v:A:c', ['valgrind'])
+    optlist, args = getopt.getopt(args, 'hp:t:v:A:c',
+                                  ['valgrind', 'perf', 'features', 'report=',
+                                   'baseline=', 'threshold='])
     for (opt, val) in optlist:
         if opt == '-h':
             usage(name)
@@ -181,6 +360,16 @@ def run(name, args):
             useValgrind = True
         elif opt == '-c':
             colored = True
+        elif opt == '--perf':
+            perf = True
+        elif opt == '--features':
+            features = True
+        elif opt == '--report':
+            reportFile = val
+        elif opt == '--baseline':
+            baselineFile = val
+        elif opt == '--threshold':
+            threshold = int(val)
         else:
             print("Unrecognized option '%s'" % opt)
             usage(name)
@@ -190,7 +379,12 @@ def run(name, args):
                verbLevel=vlevel,
                autograde=autograde,
                useValgrind=useValgrind,
-               colored=colored)
+               colored=colored,
+               reportFile=reportFile,
+               baselineFile=baselineFile,
+               threshold=threshold,
+               perf=perf,
+               features=features)
     t.run(tid)
 
 
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Generate log2_lshift16.h, the integer log2 of shannon_entropy.c.
+
+log2_lshift16(x) is 8 * log2(x / 2^16), rounded up at the limits
+round(2^16 * 2^((v - 1) / 8)) of each result v from -135 to 0, and -136 below
+all of them.  It is looked up in two tables indexed by the position of the
+leading bit of 2x + 1 and the 5 bits following it: the result at the start
+of that range of x, and the last x of that result, past which it is one
+more, as no range holds more than one limit.
+
+Usage: scripts/gen-log2.py > log2_lshift16.h
+"""
+
+import math
+import sys
+
+ARG_SHIFT = 16
+RET_SHIFT = 3
+LOWEST = -136
+MANTISSA_BITS = 5
+
+# Every x from 65535 on gives 0, the highest result
+MAX_ARG = (1 << ARG_SHIFT) - 1
+EXPONENTS = ARG_SHIFT + 1
+
+
+def limit(v):
+    """Smallest x whose result is at least v"""
+    return math.floor((1 << ARG_SHIFT) * 2 ** ((v - 1) / (1 << RET_SHIFT)) +
+                      0.5)
+
+
+LIMITS = [limit(v) for v in range(LOWEST + 1, 1)]
+
+
+def log2_lshift16(x):
+    return LOWEST + sum(1 for lim in LIMITS if lim <= x)
+
+
+def index(x):
+    v = 2 * x + 1
+    e = v.bit_length() - 1
+    m = (v << (ARG_SHIFT - e) >> (ARG_SHIFT - MANTISSA_BITS)) & \
+        ((1 << MANTISSA_BITS) - 1)
+    return e << MANTISSA_BITS | m
+
+
+def tables():
+    size = EXPONENTS << MANTISSA_BITS
+    base = [0] * size
+    last = [MAX_ARG] * size
+    seen = [False] * size
+    for x in range(MAX_ARG + 1):
+        i, y = index(x), log2_lshift16(x)
+        if not seen[i]:
+            base[i], seen[i] = y, True
+        elif y != base[i] and last[i] == MAX_ARG:
+            last[i] = x - 1
+        assert y == base[i] + (x > last[i]), \
+            "x = %d: more than one limit in range %d" % (x, i)
+    return base, last
+
+
+def rows(values, fmt, per_row):
+    for i in range(0, len(values), per_row):
+        yield "    " + ", ".join(fmt % v for v in values[i:i + per_row]) + ","
+
+
+def main():
+    base, last = tables()
+    out = sys.stdout
+    out.write("""\
+/*
+ * Precalculated values of log2, with the assumption that the argument is left
+ * shifted by 16 bits and that the return value of log2_lshift16() is left
+ * shifted by 3 bits.  All the shifts avoid floating point in the calculation.
+ *
+ * Generated by scripts/gen-log2.py, do not edit.
+ */
+
+#include <stdint.h>
+
+#define LOG2_ARG_SHIFT (1 << %d)
+#define LOG2_RET_SHIFT (1 << %d)
+
+/* Result at the start of each range of arguments, and the last argument of
+ * that result, past which it is one more.  The ranges are indexed by the
+ * leading bit of 2x + 1 and the %d bits following it.
+ */
+static const int16_t log2_lshift16_base[%d] = {
+%s
+};
+
+static const uint16_t log2_lshift16_last[%d] = {
+%s
+};
+
+/* (log2(lshift16 / 2^16)) << 3, without a branch */
+static inline int log2_lshift16(uint64_t lshift16)
+{
+    uint32_t x = lshift16 < %d ? lshift16 : %d;
+    uint32_t v = 2 * x + 1;
+    int e = 31 - __builtin_clz(v);
+    uint32_t i = (uint32_t) e << %d | ((v << (%d - e)) >> %d & %d);
+    return log2_lshift16_base[i] + (x > log2_lshift16_last[i]);
+}
+""" % (ARG_SHIFT, RET_SHIFT, MANTISSA_BITS, len(base),
+       "\n".join(rows(base, "%4d", 12)), len(last),
+       "\n".join(rows(last, "%5d", 10)), MAX_ARG, MAX_ARG, MANTISSA_BITS,
+       ARG_SHIFT, ARG_SHIFT - MANTISSA_BITS, (1 << MANTISSA_BITS) - 1))
+
+
+if __name__ == "__main__":
+    main()
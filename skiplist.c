@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "random.h"
+#include "skiplist.h"
+
+/* Draw a node height: each extra level is kept with probability 1/4 */
+static int random_height(struct skiplist *sl)
+{
+    sl->seed += (uintptr_t) 0x9e3779b97f4a7c15ULL;
+    uintptr_t r = random_shuffle(sl->seed);
+    int height = 1;
+    while (height < SL_MAX_LEVEL && !(r & 3)) {
+        height++;
+        r >>= 2;
+    }
+    return height;
+}
+
+static struct sl_node *node_new(element_t *elem, int height)
+{
+    struct sl_node *node =
+        malloc(sizeof(struct sl_node) + height * sizeof(struct sl_link));
+    if (!node)
+        return NULL;
+    node->elem = elem;
+    node->height = height;
+    return node;
+}
+
+struct skiplist *sl_new(struct list_head *head)
+{
+    if (!head)
+        return NULL;
+    struct skiplist *sl = malloc(sizeof(struct skiplist));
+    if (!sl)
+        return NULL;
+    sl->head = head;
+    sl->size = 0;
+    sl->seed = (uintptr_t) sl;
+    sl->header = node_new(NULL, SL_MAX_LEVEL);
+    if (!sl->header) {
+        free(sl);
+        return NULL;
+    }
+
+    /* Append the elements one by one, remembering the last node on each
+     * level and its position, so that building takes linear time.
+     */
+    struct sl_node *tail[SL_MAX_LEVEL];
+    size_t pos[SL_MAX_LEVEL];
+    for (int lvl = 0; lvl < SL_MAX_LEVEL; lvl++) {
+        tail[lvl] = sl->header;
+        pos[lvl] = 0;
+    }
+
+    bool ok = true;
+    element_t *e;
+    list_for_each_entry (e, head, list) {
+        int height = random_height(sl);
+        struct sl_node *node = node_new(e, height);
+        if (!node) {
+            ok = false;
+            break;
+        }
+        sl->size++;
+        for (int lvl = 0; lvl < height; lvl++) {
+            tail[lvl]->link[lvl].next = node;
+            tail[lvl]->link[lvl].width = sl->size - pos[lvl];
+            tail[lvl] = node;
+            pos[lvl] = sl->size;
+        }
+    }
+
+    for (int lvl = 0; lvl < SL_MAX_LEVEL; lvl++) {
+        tail[lvl]->link[lvl].next = NULL;
+        tail[lvl]->link[lvl].width = sl->size + 1 - pos[lvl];
+    }
+
+    if (!ok) {
+        sl_free(sl);
+        return NULL;
+    }
+    return sl;
+}
+
+void sl_free(struct skiplist *sl)
+{
+    if (!sl)
+        return;
+    struct sl_node *node = sl->header;
+    while (node) {
+        struct sl_node *next = node->link[0].next;
+        free(node);
+        node = next;
+    }
+    free(sl);
+}
+
+/* Record in update[] the last node on each level which precedes the element
+ * at 1-based position pos.
+ */
+static void seek(const struct skiplist *sl, size_t pos, struct sl_node **update)
+{
+    struct sl_node *x = sl->header;
+    size_t p = 0;
+    for (int lvl = SL_MAX_LEVEL - 1; lvl >= 0; lvl--) {
+        while (x->link[lvl].next && p + x->link[lvl].width < pos) {
+            p += x->link[lvl].width;
+            x = x->link[lvl].next;
+        }
+        update[lvl] = x;
+    }
+}
+
+element_t *sl_at(const struct skiplist *sl, size_t idx)
+{
+    if (idx >= sl->size)
+        return NULL;
+    struct sl_node *update[SL_MAX_LEVEL];
+    seek(sl, idx + 1, update);
+    return update[0]->link[0].next->elem;
+}
+
+element_t *sl_insert_sorted(struct skiplist *sl, const char *s)
+{
+    struct sl_node *update[SL_MAX_LEVEL];
+    size_t rank[SL_MAX_LEVEL];
+    struct sl_node *x = sl->header;
+    size_t p = 0;
+    for (int lvl = SL_MAX_LEVEL - 1; lvl >= 0; lvl--) {
+        while (x->link[lvl].next &&
+               strcmp(x->link[lvl].next->elem->value, s) <= 0) {
+            p += x->link[lvl].width;
+            x = x->link[lvl].next;
+        }
+        update[lvl] = x;
+        rank[lvl] = p;
+    }
+
+    element_t *e = malloc(sizeof(element_t));
+    if (!e)
+        return NULL;
+    e->value = strdup(s);
+    if (!e->value) {
+        free(e);
+        return NULL;
+    }
+    int height = random_height(sl);
+    struct sl_node *node = node_new(e, height);
+    if (!node) {
+        q_release_element(e);
+        return NULL;
+    }
+
+    size_t pos = p + 1;
+    for (int lvl = 0; lvl < height; lvl++) {
+        struct sl_link *prev = &update[lvl]->link[lvl];
+        node->link[lvl].next = prev->next;
+        node->link[lvl].width = prev->width + rank[lvl] + 1 - pos;
+        prev->next = node;
+        prev->width = pos - rank[lvl];
+    }
+    for (int lvl = height; lvl < SL_MAX_LEVEL; lvl++)
+        update[lvl]->link[lvl].width++;
+
+    list_add(&e->list, x == sl->header ? sl->head : &x->elem->list);
+    sl->size++;
+    return e;
+}
+
+element_t *sl_remove_at(struct skiplist *sl, size_t idx)
+{
+    if (idx >= sl->size)
+        return NULL;
+    struct sl_node *update[SL_MAX_LEVEL];
+    seek(sl, idx + 1, update);
+
+    struct sl_node *node = update[0]->link[0].next;
+    for (int lvl = 0; lvl < node->height; lvl++) {
+        struct sl_link *prev = &update[lvl]->link[lvl];
+        prev->next = node->link[lvl].next;
+        prev->width += node->link[lvl].width - 1;
+    }
+    for (int lvl = node->height; lvl < SL_MAX_LEVEL; lvl++)
+        update[lvl]->link[lvl].width--;
+
+    element_t *e = node->elem;
+    list_del_init(&e->list);
+    free(node);
+    sl->size--;
+    return e;
+}
+
+bool sl_delete_mid(struct skiplist *sl)
+{
+    element_t *e = sl_remove_at(sl, sl->size / 2);
+    if (!e)
+        return false;
+    q_release_element(e);
+    return true;
+}
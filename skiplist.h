@@ -0,0 +1,122 @@
+#ifndef LAB0_SKIPLIST_H
+#define LAB0_SKIPLIST_H
+
+/* Indexable skip list layered over the element chain of a queue.
+ *
+ * The index keeps one node per queue element, in the same order as the
+ * circular doubly-linked list, and records on every forward link how many
+ * elements it skips.  This turns positional access into an O(log n) walk,
+ * while the queue itself stays a plain list that every q_* function can
+ * still operate on.  Operations going through the index keep the list and
+ * the index in step; any other modification of the queue leaves the index
+ * stale, so it has to be freed and rebuilt.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "queue.h"
+
+/* Skipping probability is 1/4, so 16 levels cover 2^32 elements */
+#define SL_MAX_LEVEL 16
+
+struct sl_node;
+
+/**
+ * struct sl_link - Forward link of a skip list node
+ * @next: following node on this level, NULL past the last element
+ * @width: number of elements between this node and @next, counting @next
+ *         and treating the end of the list as the (size + 1)th position
+ */
+struct sl_link {
+    struct sl_node *next;
+    size_t width;
+};
+
+/**
+ * struct sl_node - Skip list node referring to one queue element
+ * @elem: indexed element
+ * @height: number of levels this node is linked on
+ * @link: forward links, one per level
+ */
+struct sl_node {
+    element_t *elem;
+    int height;
+    struct sl_link link[];
+};
+
+/**
+ * struct skiplist - Index of a queue
+ * @head: header of the indexed queue
+ * @size: number of indexed elements
+ * @seed: state of the generator drawing node heights
+ * @header: sentinel node before the first element, linked on all levels
+ */
+struct skiplist {
+    struct list_head *head;
+    size_t size;
+    uintptr_t seed;
+    struct sl_node *header;
+};
+
+/**
+ * sl_new() - Build an index over the elements currently in a queue
+ * @head: header of queue
+ *
+ * Takes O(n) time.
+ *
+ * Return: the index, NULL if queue is NULL or allocation failed
+ */
+struct skiplist *sl_new(struct list_head *head);
+
+/**
+ * sl_free() - Free the index, leaving the indexed queue untouched
+ * @sl: index, no effect if NULL
+ */
+void sl_free(struct skiplist *sl);
+
+/**
+ * sl_at() - Find the element at a given position
+ * @sl: index
+ * @idx: 0-based position
+ *
+ * Return: the element, NULL if @idx is out of range
+ */
+element_t *sl_at(const struct skiplist *sl, size_t idx);
+
+/**
+ * sl_insert_sorted() - Insert a string in sorted position
+ * @sl: index
+ * @s: string would be inserted
+ *
+ * The queue is assumed to be sorted in ascending order.  The new element is
+ * placed after all the elements not greater than @s, so that insertion is
+ * stable.  The string is copied as with q_insert_head().
+ *
+ * Return: the new element, NULL for allocation failed
+ */
+element_t *sl_insert_sorted(struct skiplist *sl, const char *s);
+
+/**
+ * sl_remove_at() - Remove the element at a given position
+ * @sl: index
+ * @idx: 0-based position
+ *
+ * Unlinks the element from both the index and the queue without freeing it.
+ *
+ * Return: the removed element, NULL if @idx is out of range
+ */
+element_t *sl_remove_at(struct skiplist *sl, size_t idx);
+
+/**
+ * sl_delete_mid() - Delete the middle node in queue
+ * @sl: index
+ *
+ * Same semantics as q_delete_mid(), in O(log n) time.
+ *
+ * Return: true for success, false if the queue is empty
+ */
+bool sl_delete_mid(struct skiplist *sl);
+
+#endif /* LAB0_SKIPLIST_H */
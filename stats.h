@@ -0,0 +1,122 @@
+#ifndef LAB0_STATS_H
+#define LAB0_STATS_H
+
+/* Instrumentation of the queue algorithms.
+ *
+ * Building with QUEUE_STATS defined ("make STATS=1") makes queue.c and
+ * list_sort count the string comparisons they make, the nodes they step
+ * through and the link pointers they store.  Otherwise the STAT_*() macros
+ * expand to nothing, and the code is the same as without them.
+ *
+ * The counters are plain globals, not updated atomically, so they are only
+ * meaningful when a single thread runs queue code.
+ */
+
+#ifdef QUEUE_STATS
+
+#include <stdint.h>
+
+/**
+ * struct queue_stats - Counts of the operations of the queue algorithms
+ * @cmps: comparisons of two strings
+ * @visits: steps from a node to another one
+ * @writes: stores to the next or prev pointer of a node or list head
+ */
+struct queue_stats {
+    uint64_t cmps, visits, writes;
+};
+
+/* Counts since the program started or was last reset by the user */
+extern struct queue_stats queue_stats;
+
+#define STAT_CMP() (queue_stats.cmps++)
+#define STAT_VISIT() (queue_stats.visits++)
+#define STAT_WRITE(n) (queue_stats.writes += (n))
+
+#else
+
+#define STAT_CMP() \
+    do {           \
+    } while (0)
+#define STAT_VISIT() \
+    do {             \
+    } while (0)
+#define STAT_WRITE(n) \
+    do {              \
+    } while (0)
+
+#endif /* QUEUE_STATS */
+
+/* The helpers of list.h, counting the pointers they store.  The counts follow
+ * the definitions of list.h, which must not change, and are only kept here.
+ */
+#include "list.h"
+
+#ifdef LIST_POISONING
+#define LIST_DEL_WRITES 4
+#else
+#define LIST_DEL_WRITES 2
+#endif
+
+#define STAT_INIT_LIST_HEAD(head) \
+    do {                          \
+        INIT_LIST_HEAD(head);     \
+        STAT_WRITE(2);            \
+    } while (0)
+
+#define STAT_LIST_ADD(node, head) \
+    do {                          \
+        list_add(node, head);     \
+        STAT_WRITE(4);            \
+    } while (0)
+
+#define STAT_LIST_ADD_TAIL(node, head) \
+    do {                               \
+        list_add_tail(node, head);     \
+        STAT_WRITE(4);                 \
+    } while (0)
+
+#define STAT_LIST_DEL(node)          \
+    do {                             \
+        list_del(node);              \
+        STAT_WRITE(LIST_DEL_WRITES); \
+    } while (0)
+
+#define STAT_LIST_DEL_INIT(node)         \
+    do {                                 \
+        list_del_init(node);             \
+        STAT_WRITE(LIST_DEL_WRITES + 2); \
+    } while (0)
+
+#define STAT_LIST_MOVE(node, head)       \
+    do {                                 \
+        list_move(node, head);           \
+        STAT_WRITE(LIST_DEL_WRITES + 4); \
+    } while (0)
+
+/* Splicing an empty list stores nothing, and cutting from an empty list
+ * either, while cutting no node off only initializes the new list
+ */
+#define LIST_SPLICE_WRITES(list) (list_empty(list) ? 0 : 4)
+#define LIST_CUT_WRITES(head_from, node)                        \
+    (list_empty(head_from) ? 0 : (head_from) == (node) ? 2 : 6)
+
+#define STAT_LIST_SPLICE(list, head)          \
+    do {                                      \
+        STAT_WRITE(LIST_SPLICE_WRITES(list)); \
+        list_splice(list, head);              \
+    } while (0)
+
+#define STAT_LIST_SPLICE_INIT(list, head)         \
+    do {                                          \
+        STAT_WRITE(LIST_SPLICE_WRITES(list) + 2); \
+        list_splice_init(list, head);             \
+    } while (0)
+
+#define STAT_LIST_CUT_POSITION(head_to, head_from, node) \
+    do {                                                 \
+        STAT_WRITE(LIST_CUT_WRITES(head_from, node));    \
+        list_cut_position(head_to, head_from, node);     \
+    } while (0)
+
+#endif /* LAB0_STATS_H */
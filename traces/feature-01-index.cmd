@@ -0,0 +1,29 @@
+# Test of insert sorted, remove at index and delete middle through the index
+option fail 0
+option malloc 0
+new
+ih gerbil
+ih bear
+ih dolphin
+sort
+isort cat
+isort zebra
+isort bear 2
+ri 1 bear
+ri 4 gerbil
+dm
+ri 0 bear
+it lion
+ri 3 lion
+ri 1 dolphin
+rh bear
+rh zebra
+free
+new
+ih RAND 100000
+sort
+isort meerkat 100000
+ri 199999
+ri 0
+dm
+free
@@ -0,0 +1,32 @@
+# Test of rank, range count and range delete through the order-statistic tree
+option fail 0
+option malloc 0
+option treecheck 1
+new
+ih gerbil
+ih bear
+ih dolphin
+ih zebra
+ih bear
+ih meerkat
+rank dolphin
+rank cat
+count bear dolphin
+count lion zebra
+count zebra bear
+rdel cat lion
+rank dolphin
+rh meerkat
+rh bear
+rh zebra
+rh bear
+free
+new
+ih RAND 300000
+rank m
+count b d
+rdel b d
+count a e
+rdel a z
+size
+free
@@ -0,0 +1,29 @@
+# Test of a queue in heap mode: insertion at either end and removal of the
+# minimum
+option fail 0
+option malloc 0
+new heap
+ih RAND 200000
+it RAND 200000
+rhq 300000
+size
+rhq 100000
+size
+ih gerbil
+it bear
+ih dolphin
+it zebra
+ih bear
+ih meerkat
+size
+rh bear
+rh bear
+rh dolphin
+ih aardvark
+rh aardvark
+rhq 2
+new
+ih lion
+prev
+rh zebra
+size
@@ -0,0 +1,22 @@
+# Test of list_sort, both specialized and through the comparison pointer
+option fail 0
+option malloc 0
+new
+ih dolphin
+ih bear
+ih gerbil
+it bear
+it aardvark
+list_sort
+rh aardvark
+rh bear
+rh bear
+rh dolphin
+rh gerbil
+ih RAND 100000
+it RAND 100000
+list_sort
+reverse
+option generic 1
+list_sort
+free
@@ -0,0 +1,51 @@
+# Test of sorting and merging in length, natural and descending orders
+option fail 0
+option malloc 0
+new
+ih a10
+ih b
+ih a9
+ih abc
+ih a010
+ih x2y
+ih x10y
+ih x2y
+option sortmode 1
+sort
+rh b
+rh a9
+rh a10
+option sortmode 2
+option descend 1
+list_sort
+rh x10y
+rh x2y
+rh x2y
+rh abc
+rh a010
+option descend 0
+ih f7
+ih f100
+ih f08
+sort
+new
+ih f9
+ih f10
+ih f007
+sort
+merge
+rh f007
+rh f7
+rh f08
+rh f9
+rh f10
+rh f100
+option sortmode 1
+option descend 1
+ih RAND 50000
+sort
+option generic 1
+list_sort
+option sortmode 0
+list_sort
+free
@@ -0,0 +1,11 @@
+# Test of allocating and freeing from several threads at once, with blocks
+# freed by another thread than the one allocating them
+option fail 0
+option malloc 0
+new
+ih dolphin 100
+mtalloc 5000
+mtalloc 1000 16
+mtalloc 1 64
+rh dolphin
+free
@@ -0,0 +1,7 @@
+# Test of the complexity command on operations of known complexity, at small
+# sizes
+option fail 0
+option malloc 0
+complexity ih 16384 1
+complexity rt 16384 1
+complexity size 16384 n
@@ -0,0 +1,6 @@
+# Test of measuring in simulation mode with two workers, each pinned to a CPU
+option workers 2
+option simulation 1
+it
+rh
+option simulation 0
@@ -0,0 +1,17 @@
+# Test of keeping the statistics of constant time tests in a file, merging
+# them from another file, streaming them, then continuing from them
+option simulation 1
+ctstream /tmp/qtest-scratch/stats.json 5000
+ctstate /tmp/qtest-scratch/a.state
+it
+ctstate /tmp/qtest-scratch/b.state
+it
+ih
+ctmerge /tmp/qtest-scratch/a.state
+ctstate /tmp/qtest-scratch/a.state
+it
+ctstate /tmp/qtest-scratch/b.state
+ih
+ctstate
+ctstream
+option simulation 0
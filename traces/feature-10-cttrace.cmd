@@ -0,0 +1,7 @@
+# Test of recording the measurements of a simulation in a trace, which the
+# driver then checks with cthist
+option simulation 1
+cttrace /tmp/qtest-scratch/rh.trace
+rh
+cttrace
+option simulation 0
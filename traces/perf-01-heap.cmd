@@ -0,0 +1,111 @@
+# Benchmark of a priority queue workload on 1M items: batches of inserts
+# followed by removals of the smallest items, first on a list which is sorted
+# before removing from its head, then on a queue in heap mode
+option fail 0
+option malloc 0
+new
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time ih RAND 50000
+time sort
+time rhq 45000
+time rhq 100000
+free
+new heap
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time ih RAND 50000
+time rhq 45000
+time rhq 100000
+free
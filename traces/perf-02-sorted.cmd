@@ -0,0 +1,9 @@
+# Benchmark of sorting a sorted queue: sort finds a single run and finishes
+# in linear time
+option fail 0
+option malloc 0
+new
+ih RAND 300000
+sort
+time sort
+free
@@ -0,0 +1,10 @@
+# Benchmark of sorting a reverse-sorted queue: sort reverses the single
+# descending run in place
+option fail 0
+option malloc 0
+new
+ih RAND 300000
+sort
+reverse
+time sort
+free
@@ -0,0 +1,11 @@
+# Benchmark of sorting a sorted queue with 1% of its nodes out of place:
+# sort merges the long runs left between them, galloping through the blocks
+# which do not interleave
+option fail 0
+option malloc 0
+new
+ih RAND 300000
+sort
+perturb 1500
+time sort
+free
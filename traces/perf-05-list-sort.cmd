@@ -0,0 +1,20 @@
+# Benchmark of list_sort calling its comparison through a pointer (generic)
+# against the instance specialized with LIST_SORT_DEFINE.  Both sort the same
+# nodes, reshuffled by perturb, so that they see the same memory layout.
+option fail 0
+option malloc 0
+new
+ih RAND 400000
+list_sort
+perturb 2000000
+time list_sort
+option generic 1
+perturb 2000000
+time list_sort
+option generic 0
+perturb 2000000
+time list_sort
+option generic 1
+perturb 2000000
+time list_sort
+free
@@ -0,0 +1,12 @@
+# Performance of a queue of 10M elements, far beyond the caches: every pass
+# over the queue is bound by memory latency once sort scatters the nodes
+option fail 0
+option malloc 0
+option timelimit 60
+new
+time it RAND 10000000
+time size
+time sort
+time size
+time reverse
+time free
@@ -0,0 +1,15 @@
+# Performance on strings of up to 4KB, which are copied on insertion and
+# removal, and take as much memory as 100 short strings each
+option fail 0
+option malloc 0
+option timelimit 10
+option randlen 4096
+option length 4096
+new
+time it RAND 100000
+time sort
+time reverse
+time list_sort
+time dedup
+time rhq 50000
+time free
@@ -0,0 +1,200 @@
+# Merge of 64 sorted queues of 10000 elements.  Merging them one after
+# another walks the merged list again for every queue, which takes time
+# proportional to the number of queues times the number of elements
+option fail 0
+option malloc 0
+option timelimit 20
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+new
+it RAND 10000
+sort
+time merge
+time size
@@ -0,0 +1,26 @@
+# Sort of 1M elements in orders which defeat the shortcuts of sorting
+# algorithms: runs of 2 (swap), sawtooth of descending runs (reverseK), a V
+# shape (reverseK over most of the queue), equal strings, and a reversed
+# queue with duplicates, whose descending runs break at every pair of equal
+# strings
+option fail 0
+option malloc 0
+option timelimit 10
+new
+it RAND 1000000
+sort
+time swap
+time sort
+time reverseK 1000
+time sort
+time reverseK 600000
+time sort
+time reverse
+time sort
+time list_sort
+free
+new
+it gerbil 1000000
+time sort
+time list_sort
+free
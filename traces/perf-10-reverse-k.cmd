@@ -0,0 +1,13 @@
+# reverseK on 1M elements with groups from 3 elements, the most groups and
+# thus cut and splice operations, up to a group of nearly the whole queue
+option fail 0
+option malloc 0
+option timelimit 10
+new
+it RAND 1000000
+time reverseK 3
+time reverseK 2
+time reverseK 1000
+time reverseK 500000
+time reverseK 999999
+free